@@ -0,0 +1,237 @@
+// Times the batched banded solvers against solving one strand after the
+// other and against Eigen's SparseLU, on systems shaped like the implicit
+// step of the elastic rods: mass plus a stretch Laplacian and a bending
+// bi-Laplacian per strand.
+//
+// Usage: bandedSolverBenchmark [strands] [particles per strand]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseLU>
+
+#include "bandedSolver.h"
+
+using namespace std;
+
+struct Pentadiagonal {
+  vector<double> a, b, c;
+  vector<double> x, y, z;
+};
+
+// Random systems, entry i of strand s at i * strands + s
+static Pentadiagonal buildSystems(int strands, int n, mt19937 &rng) {
+  uniform_real_distribution<double> uniform(0.5, 2.0);
+  Pentadiagonal p;
+  p.a.assign(n * strands, 0.0);
+  p.b.assign(n * strands, 0.0);
+  p.c.assign(n * strands, 0.0);
+  for (int s = 0; s < strands; s++) {
+    double mass = uniform(rng);
+    for (int i = 0; i < n; i++) {
+      p.a[i * strands + s] += mass;
+    }
+    for (int j = 0; j + 1 < n; j++) {
+      double k = 10.0 * uniform(rng);
+      p.a[j * strands + s] += k;
+      p.a[(j + 1) * strands + s] += k;
+      p.b[j * strands + s] -= k;
+    }
+    for (int i = 1; i + 1 < n; i++) {
+      double k = uniform(rng);
+      p.a[(i - 1) * strands + s] += k;
+      p.a[i * strands + s] += 4.0 * k;
+      p.a[(i + 1) * strands + s] += k;
+      p.b[(i - 1) * strands + s] -= 2.0 * k;
+      p.b[i * strands + s] -= 2.0 * k;
+      p.c[(i - 1) * strands + s] += k;
+    }
+  }
+  for (int i = 0; i < n * strands; i++) {
+    p.x.push_back(uniform(rng));
+    p.y.push_back(uniform(rng));
+    p.z.push_back(uniform(rng));
+  }
+  return p;
+}
+
+// Same systems with each strand contiguous
+static Pentadiagonal deinterleave(const Pentadiagonal &p, int strands, int n) {
+  Pentadiagonal q = p;
+  for (int s = 0; s < strands; s++) {
+    for (int i = 0; i < n; i++) {
+      int from = i * strands + s, to = s * n + i;
+      q.a[to] = p.a[from];
+      q.b[to] = p.b[from];
+      q.c[to] = p.c[from];
+      q.x[to] = p.x[from];
+      q.y[to] = p.y[from];
+      q.z[to] = p.z[from];
+    }
+  }
+  return q;
+}
+
+static double seconds(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *name, double time, int strands, int n, double error) {
+  cout << "  " << name << ": " << time * 1e3 << " ms, " << time * 1e9 / (strands * n)
+       << " ns per row, max difference " << error << endl;
+}
+
+int main(int argc, char **argv) {
+  int strands = argc > 1 ? atoi(argv[1]) : 10000;
+  int n = argc > 2 ? atoi(argv[2]) : 32;
+  int rounds = 10;
+  mt19937 rng(1);
+
+  cout << strands << " strands of " << n << " particles, best of " << rounds << endl;
+
+  Pentadiagonal systems = buildSystems(strands, n, rng);
+  Pentadiagonal contiguous = deinterleave(systems, strands, n);
+
+  cout << "pentadiagonal, factor and solve for 3 right hand sides" << endl;
+
+  // Batched, interleaved
+  Pentadiagonal batched;
+  double best = 1e30;
+  for (int r = 0; r < rounds; r++) {
+    batched = systems;
+    auto start = chrono::steady_clock::now();
+    factorPentadiagonal(n, strands, batched.a.data(), batched.b.data(), batched.c.data());
+    solvePentadiagonal(n, strands, batched.a.data(), batched.b.data(), batched.c.data(),
+                       batched.x.data(), batched.y.data(), batched.z.data());
+    best = min(best, seconds(start));
+  }
+  batched = deinterleave(batched, strands, n);
+  report("batched", best, strands, n, 0.0);
+
+  // One strand after the other
+  Pentadiagonal serial;
+  best = 1e30;
+  for (int r = 0; r < rounds; r++) {
+    serial = contiguous;
+    auto start = chrono::steady_clock::now();
+    for (int s = 0; s < strands; s++) {
+      int o = s * n;
+      factorPentadiagonal(n, 1, &serial.a[o], &serial.b[o], &serial.c[o]);
+      solvePentadiagonal(n, 1, &serial.a[o], &serial.b[o], &serial.c[o],
+                         &serial.x[o], &serial.y[o], &serial.z[o]);
+    }
+    best = min(best, seconds(start));
+  }
+  double error = 0;
+  for (int i = 0; i < n * strands; i++) {
+    error = max(error, fabs(serial.x[i] - batched.x[i]));
+  }
+  report("per strand", best, strands, n, error);
+
+  // SparseLU on one block diagonal matrix, so Eigen gets to analyze the
+  // pattern once
+  typedef Eigen::SparseMatrix<double> Matrix;
+  vector<Eigen::Triplet<double>> entries;
+  for (int s = 0; s < strands; s++) {
+    int o = s * n;
+    for (int i = 0; i < n; i++) {
+      entries.push_back(Eigen::Triplet<double>(o + i, o + i, contiguous.a[o + i]));
+      if (i + 1 < n) {
+        entries.push_back(Eigen::Triplet<double>(o + i, o + i + 1, contiguous.b[o + i]));
+        entries.push_back(Eigen::Triplet<double>(o + i + 1, o + i, contiguous.b[o + i]));
+      }
+      if (i + 2 < n) {
+        entries.push_back(Eigen::Triplet<double>(o + i, o + i + 2, contiguous.c[o + i]));
+        entries.push_back(Eigen::Triplet<double>(o + i + 2, o + i, contiguous.c[o + i]));
+      }
+    }
+  }
+  Matrix matrix(n * strands, n * strands);
+  matrix.setFromTriplets(entries.begin(), entries.end());
+  matrix.makeCompressed();
+
+  Eigen::MatrixXd rhs(n * strands, 3), solution;
+  for (int i = 0; i < n * strands; i++) {
+    rhs(i, 0) = contiguous.x[i];
+    rhs(i, 1) = contiguous.y[i];
+    rhs(i, 2) = contiguous.z[i];
+  }
+
+  Eigen::SparseLU<Matrix> lu;
+  lu.analyzePattern(matrix);
+  best = 1e30;
+  for (int r = 0; r < rounds; r++) {
+    auto start = chrono::steady_clock::now();
+    lu.factorize(matrix);
+    solution = lu.solve(rhs);
+    best = min(best, seconds(start));
+  }
+  error = 0;
+  for (int i = 0; i < n * strands; i++) {
+    error = max(error, fabs(solution(i, 0) - batched.x[i]));
+  }
+  report("SparseLU", best, strands, n, error);
+
+  cout << "tridiagonal, one right hand side" << endl;
+
+  vector<double> lower(n * strands), diag(n * strands), upper(n * strands);
+  vector<double> right(n * strands), scratch(n * strands), result;
+  // Not symmetric, the lower band is half the upper one
+  for (int i = 0; i < n * strands; i++) {
+    upper[i] = systems.b[i];
+    lower[i] = i >= strands ? 0.5 * systems.b[i - strands] : 0.0;
+    diag[i] = systems.a[i];
+    right[i] = systems.x[i];
+  }
+
+  best = 1e30;
+  for (int r = 0; r < rounds; r++) {
+    result = right;
+    auto start = chrono::steady_clock::now();
+    solveTridiagonal(n, strands, lower.data(), diag.data(), upper.data(), result.data(),
+                     scratch.data());
+    best = min(best, seconds(start));
+  }
+  report("batched", best, strands, n, 0.0);
+
+  entries.clear();
+  for (int s = 0; s < strands; s++) {
+    for (int i = 0; i < n; i++) {
+      int row = s * n + i;
+      entries.push_back(Eigen::Triplet<double>(row, row, diag[i * strands + s]));
+      if (i > 0) entries.push_back(Eigen::Triplet<double>(row, row - 1, lower[i * strands + s]));
+      if (i + 1 < n) entries.push_back(Eigen::Triplet<double>(row, row + 1, upper[i * strands + s]));
+    }
+  }
+  Matrix tridiagonal(n * strands, n * strands);
+  tridiagonal.setFromTriplets(entries.begin(), entries.end());
+  tridiagonal.makeCompressed();
+
+  Eigen::VectorXd b(n * strands), v;
+  for (int s = 0; s < strands; s++) {
+    for (int i = 0; i < n; i++) {
+      b(s * n + i) = right[i * strands + s];
+    }
+  }
+
+  lu.analyzePattern(tridiagonal);
+  best = 1e30;
+  for (int r = 0; r < rounds; r++) {
+    auto start = chrono::steady_clock::now();
+    lu.factorize(tridiagonal);
+    v = lu.solve(b);
+    best = min(best, seconds(start));
+  }
+  error = 0;
+  for (int s = 0; s < strands; s++) {
+    for (int i = 0; i < n; i++) {
+      error = max(error, fabs(v(s * n + i) - result[i * strands + s]));
+    }
+  }
+  report("SparseLU", best, strands, n, error);
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <math.h>
 #include <random>
@@ -5,11 +7,26 @@
 #include "./CGL/matrix3x3.h"
 
 #include "HairVector.h"
+#include "collision/collisionBVH.h"
+#include "forceField.h"
+#include "hairGrid.h"
+#include "strandSolver.h"
+#include "rootAnimation.h"
 
 using namespace std;
 
 HairVector::~HairVector() {
-  hair_vector->clear();
+  for (Hair *hair : *hair_vector) {
+    delete hair;
+  }
+  delete hair_vector;
+  for (StrandSolver *s : solvers) {
+    delete s;
+  }
+  delete root_animation;
+  delete force_fields;
+  delete volume;
+  delete collision_bvh;
 }
 
 void HairVector::buildGrid(Vector3D start_pos) {
@@ -20,73 +37,343 @@ void HairVector::buildGrid(Vector3D start_pos) {
   Vector3D new_pos = start_pos;
   for (int i = 0; i < particles_count; i++){
 //    double x_pos = -5.0 + ((i % 2) * 10.0);
-    double x_pos = (i % 2) * (((double) rand()/RAND_MAX) * 5.0 + 2.5);
+    double x_pos = (i % 2) * (uniform() * 5.0 + 2.5);
     double y_pos = space;
 
 //    double r = (double) rand()/RAND_MAX;
 //    double z_pos = (r * 2.0 - 1.0)/ 1000.0;
     double z_pos = 0;
 
-    PointMass *m = new PointMass(new_pos, pinned);
+    PointMass m(new_pos, pinned);
     Vector3D pos = new_pos + (Vector3D(x_pos, y_pos, z_pos).unit() * hair->avg_spring_length);
     new_pos = pos;
 
-    hair->point_masses.push_back(*m);
+    hair->point_masses.push_back(m);
     pinned = false;
   }
 
-  // create stretch springs
-  for (int i = 0; i < particles_count - 1; i++){
-    PointMass* pm1 = &(hair->point_masses[i]);
-    PointMass* pm2 = &(hair->point_masses[i+1]);
-    double spring_length = (pm2->position - pm1->position).norm();
-    Spring* s = new Spring(pm1, pm2, spring_length);
-    hair->springs.push_back(*s);
-  }
-
-  //  create support springs 
-  for (int j = 0; j < hair->point_masses.size() - 2; j++) { 
-    PointMass* pm1 = &(hair->point_masses[j]);
-    PointMass* pm2 = &(hair->point_masses[j+2]); 
-    double spring_length = (pm2->start_position - pm1->start_position).norm(); 
-    Spring* s = new Spring(pm1, pm2, spring_length); 
-    hair->support_springs.push_back(*s); 
-  }
-
-//  restBendSmoothingFunction();
-//  restCoreSmoothingFunction();
-//
-//  for (int i = 0; i < point_masses.size() - 1; i++) {
-//    Vector3D rest_edge = point_masses[i+1].start_position - point_masses[i].start_position;
-//
-//    if (i == 0) {
-//      (&point_masses[i])->ref_vector = Vector3D();
-//    } else {
-//      Vector3D frame_1 = (point_masses[i].rest_bend_smoothed_position - point_masses[i-1].rest_bend_smoothed_position).unit();
-//      Vector3D frame_2 = cross(frame_1, Vector3D(0, 0, 1)).unit();
-//
-//      double frame_coord[] = {
-//              frame_1.x, frame_2.x, 0.0,
-//              frame_1.y, frame_2.y, 0.0,
-//              frame_1.z, frame_2.z, 1.0
-//      };
-//
-//      (&point_masses[i])->ref_vector = Matrix3x3(frame_coord).T() * rest_edge;
-//    }
-//  }
+  hair->full_start_positions.clear();
+  for (PointMass &pm : hair->point_masses) {
+    hair->full_start_positions.push_back(pm.start_position);
+  }
+  hair->buildSprings();
+
   hair_vector->push_back(hair);
 }
 
 
+double HairVector::uniform() {
+  return uniform_real_distribution<double>(0.0, 1.0)(rng);
+}
+
+void HairVector::setSolver(StrandSolver *new_solver) {
+  if (find(solvers.begin(), solvers.end(), new_solver) == solvers.end()) {
+    solvers.push_back(new_solver);
+  }
+  solver = new_solver;
+  solver->reset(this);
+}
+
+// The solver of that name the strands had before, or a new one, null for an
+// unknown name
+StrandSolver *HairVector::solverNamed(const string &name) {
+  for (StrandSolver *s : solvers) {
+    if (s->name() == name) return s;
+  }
+  StrandSolver *s = createStrandSolver(name);
+  if (s) solvers.push_back(s);
+  return s;
+}
+
 void HairVector::simulate(double frames_per_sec, double simulation_steps, vector<Vector3D> external_accelerations) {
-  for (Hair* hair : *hair_vector) {
+  double delta_t = 1.0f / frames_per_sec / simulation_steps;
+
+  if (!solver) {
+    solver = solverNamed("mass spring");
+  }
+  solver->stats.steps++;
+  setStepSize(delta_t);
+
+  if (root_animation) {
+    root_animation->apply(this, time + delta_t);
+  }
+
+  // Any change of the external accelerations wakes every strand
+  Vector3D total_accel;
+  for (Vector3D &accel : external_accelerations) {
+    total_accel += accel;
+  }
+  if (!(total_accel == last_total_accel)) {
+    wake();
+    last_total_accel = total_accel;
+  }
+
+  if (force_fields) {
+    force_fields->update(this, time);
+  }
+
+  if (volume) {
+    volume->build(this, delta_t);
+  }
+
+  if (collision_objects) {
+    if (!collision_bvh) {
+      collision_bvh = new CollisionBVH();
+    }
+    collision_bvh->update(*collision_objects, frame != collision_frame);
+    collision_frame = frame;
+  }
+
+  for (int s = 0; s < hair_vector->size(); s++) {
+    Hair *hair = (*hair_vector)[s];
+    if (hair->asleep) {
+      PointMass &root = hair->point_masses[0];
+      if (enable_sleep && root.position == root.last_position && !colliderMoved(hair)) continue;
+      hair->wake();
+    }
+
+    double mass = hair->length * density / hair->particles_count;
+
+    if (volume) {
+      volume->smoothVelocities(hair, delta_t);
+    }
+
     hair->externalForces(frames_per_sec, simulation_steps, external_accelerations, density);
-    hair->restCoreSmoothingFunction(ac);
-    if (enable_stretch_constraints) { hair->stretchSpring(frames_per_sec, simulation_steps, ks, cs, ab); }
-    if (enable_support_constraints) { hair->supportSpring(frames_per_sec, simulation_steps, kb, cb, ab); }
-//    if (enable_bending_constraints) { hair->bendSpring(frames_per_sec, simulation_steps, kb, cb, ab); }
-    if (enable_core_constraints) { hair->coreSpring(frames_per_sec, simulation_steps, kc, cc, ac); }
-    hair->updatePositions(frames_per_sec, simulation_steps, density, damping);
+    if (force_fields) {
+      force_fields->apply(hair, mass);
+    }
+    if (volume) {
+      volume->applyRepulsion(hair, mass);
+    }
+
+    auto start = chrono::steady_clock::now();
+    solver->step(this, hair, s, frames_per_sec, simulation_steps);
+    solver->stats.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    solver->stats.strand_steps++;
+    solver->stats.particle_steps += hair->point_masses.size();
+
+    if (collision_objects) {
+      collide(hair);
+    }
+
+    if (enable_sleep) {
+      if (hair->kineticEnergy(delta_t) < sleep_energy) {
+        if (++hair->still_steps >= sleep_steps) hair->sleep();
+      } else {
+        hair->still_steps = 0;
+      }
+    }
+  }
+
+  time += delta_t;
+}
+
+// Box around the whole step of the strand
+static void stepBounds(Hair *hair, Vector3D &lo, Vector3D &hi) {
+  vector<PointMass> &pms = hair->point_masses;
+  lo = pms[0].position;
+  hi = lo;
+  for (PointMass &pm : pms) {
+    for (int k = 0; k < 3; k++) {
+      lo[k] = min(lo[k], min(pm.position[k], pm.last_position[k]));
+      hi[k] = max(hi[k], max(pm.position[k], pm.last_position[k]));
+    }
+  }
+}
+
+bool HairVector::colliderMoved(Hair *hair) {
+  if (!collision_bvh || !collision_bvh->anyMoved()) return false;
+  Vector3D lo, hi;
+  stepBounds(hair, lo, hi);
+  return collision_bvh->moved(lo, hi);
+}
+
+void HairVector::collide(Hair *hair) {
+  vector<PointMass> &pms = hair->point_masses;
+
+  // Only the colliders near the whole step of the strand
+  Vector3D lo, hi;
+  stepBounds(hair, lo, hi);
+  vector<CollisionObject *> candidates;
+  collision_bvh->query(lo, hi, candidates);
+
+  for (CollisionObject *co : candidates) {
+    for (PointMass &pm : pms) {
+      if (!pm.pinned) co->collide(pm);
+    }
+    // Segments can cut through a collider between two particles outside it
+    for (int i = 0; i + 1 < pms.size(); i++) {
+      co->collideEdge(pms[i], pms[i + 1]);
+    }
   }
 }
 
+// Larger steps for the bulk of the preroll; the tail is run at the shot's
+// own step, since the strain limits make the resting pose depend slightly on it
+static const int PREROLL_STEP_SCALE = 3;
+
+int HairVector::preroll(double frames_per_sec, double simulation_steps, vector<Vector3D> external_accelerations,
+                        int max_steps, double tolerance) {
+  // Settle in the rest pose, without wind and without strands falling asleep
+  // half way
+  RootAnimation *animation = root_animation;
+  ForceFields *fields = force_fields;
+  bool sleep = enable_sleep;
+  root_animation = nullptr;
+  force_fields = nullptr;
+  enable_sleep = false;
+
+  int steps = 0;
+  for (double settle_steps : {max(1.0, round(simulation_steps / PREROLL_STEP_SCALE)), simulation_steps}) {
+    double delta_t = 1.0 / frames_per_sec / settle_steps;
+    setStepSize(delta_t);
+
+    // Kinetic damping: a strand whose energy starts dropping has just passed
+    // through its equilibrium, so it is stopped there instead of swinging
+    // back. The peaks shrink quickly without any extra viscous damping.
+    vector<double> last_energy(hair_vector->size(), 0.0);
+    int calm_steps = 0;
+    while (steps < max_steps && calm_steps < sleep_steps) {
+      simulate(frames_per_sec, settle_steps, external_accelerations);
+      steps++;
+
+      double residual = 0;
+      for (int s = 0; s < hair_vector->size(); s++) {
+        Hair *hair = (*hair_vector)[s];
+        double energy = hair->kineticEnergy(delta_t);
+        residual = max(residual, energy);
+        if (energy < last_energy[s]) {
+          hair->rescaleVelocities(0.0);
+          energy = 0;
+        }
+        last_energy[s] = energy;
+      }
+      calm_steps = residual < tolerance ? calm_steps + 1 : 0;
+    }
+  }
+
+  // Hand the groom over with velocities per substep of the shot
+  setStepSize(1.0 / frames_per_sec / simulation_steps);
+
+  root_animation = animation;
+  force_fields = fields;
+  enable_sleep = sleep;
+  wake();
+
+  // The settled groom is the first frame of the shot
+  time = 0;
+  frame = 0;
+  return steps;
+}
+
+void HairVector::wake() {
+  for (Hair* hair : *hair_vector) {
+    hair->wake();
+  }
+}
+
+void HairVector::stepMetrics(double delta_t, double &max_cfl, double &max_strain) {
+  max_cfl = 0;
+  max_strain = 0;
+
+  for (Hair* hair : *hair_vector) {
+    double speed, strain;
+    hair->stepMetrics(delta_t, speed, strain);
+    max_cfl = max(max_cfl, speed * delta_t / hair->avg_spring_length);
+    max_strain = max(max_strain, strain);
+  }
+}
+
+void HairVector::rescaleVelocities(double ratio) {
+  for (Hair* hair : *hair_vector) {
+    hair->rescaleVelocities(ratio);
+  }
+}
+
+// Verlet velocities are displacements per substep, so they keep the speed of
+// the strands only if they are scaled along with the substep
+void HairVector::setStepSize(double delta_t) {
+  if (this->delta_t > 0 && fabs(delta_t / this->delta_t - 1.0) > 1e-12) {
+    rescaleVelocities(delta_t / this->delta_t);
+  }
+  this->delta_t = delta_t;
+}
+
+int HairVector::totalParticles() {
+  int total = 0;
+  for (Hair* hair : *hair_vector) {
+    total += hair->point_masses.size();
+  }
+  return total;
+}
+
+int HairVector::lodParticles(Hair *hair, int level) {
+  int full_count = hair->full_start_positions.size();
+  return max(min(min_lod_particles, full_count), ((full_count - 1) >> level) + 1);
+}
+
+static int distanceLevel(double distance, double lod_distance) {
+  if (distance <= lod_distance) return 0;
+  return (int) floor(log2(distance / lod_distance));
+}
+
+void HairVector::updateLOD(Vector3D view_pos) {
+  int n = hair_vector->size();
+  vector<double> distance(n);
+  vector<int> level(n);
+  int total = 0;
+
+  for (int i = 0; i < n; i++) {
+    Hair *hair = (*hair_vector)[i];
+    distance[i] = (hair->point_masses[0].position - view_pos).norm();
+
+    int max_level = 0;
+    while (lodParticles(hair, max_level + 1) < lodParticles(hair, max_level)) {
+      max_level++;
+    }
+
+    // Keep a 10% margin around each switching distance so strands near it
+    // do not flip between levels every frame
+    int coarser = min(max_level, distanceLevel(distance[i] / 1.1, lod_distance));
+    int finer = min(max_level, distanceLevel(distance[i] * 1.1, lod_distance));
+    level[i] = hair->lod_level;
+    if (coarser > level[i]) {
+      level[i] = coarser;
+    } else if (finer < level[i]) {
+      level[i] = finer;
+    }
+    level[i] = enable_lod ? min(level[i], max_level) : 0;
+    total += lodParticles(hair, level[i]);
+  }
+
+  // Coarsen the farthest strands first until the group fits its budget
+  if (enable_lod && particle_budget > 0 && total > particle_budget) {
+    vector<int> order(n);
+    for (int i = 0; i < n; i++) order[i] = i;
+    sort(order.begin(), order.end(), [&](int a, int b) { return distance[a] > distance[b]; });
+
+    bool coarsened = true;
+    while (total > particle_budget && coarsened) {
+      coarsened = false;
+      for (int i : order) {
+        Hair *hair = (*hair_vector)[i];
+        int count = lodParticles(hair, level[i]);
+        int coarser_count = lodParticles(hair, level[i] + 1);
+        if (coarser_count < count) {
+          level[i]++;
+          total -= count - coarser_count;
+          coarsened = true;
+          if (total <= particle_budget) break;
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    Hair *hair = (*hair_vector)[i];
+    if (level[i] != hair->lod_level) {
+      hair->resample(lodParticles(hair, level[i]));
+      hair->lod_level = level[i];
+    }
+  }
+}
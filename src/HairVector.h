@@ -1,6 +1,8 @@
 #ifndef CLOTHSIM_HAIRVECTOR_H
 #define CLOTHSIM_HAIRVECTOR_H
 
+#include <random>
+#include <string>
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
@@ -13,19 +15,43 @@
 using namespace CGL;
 using namespace std;
 
+class RootAnimation;
+class ForceFields;
+class CollisionObject;
+class CollisionBVH;
+class HairGrid;
+class StrandSolver;
+
+// Owns the strands and everything hung off it below except the colliders
 struct HairVector {
 HairVector() {
   hair_vector = new vector<Hair *>();
 }
 HairVector(vector<Hair*> *hair_vector)
         : hair_vector(hair_vector) {}
+HairVector(const HairVector &) = delete;
+HairVector &operator=(const HairVector &) = delete;
 ~HairVector();
 
 void buildGrid(Vector3D start_pos);
 void simulate(double frames_per_sec, double simulation_steps, vector<Vector3D> external_accelerations);
+int preroll(double frames_per_sec, double simulation_steps, vector<Vector3D> external_accelerations,
+            int max_steps, double tolerance);
+void stepMetrics(double delta_t, double &max_cfl, double &max_strain);
+void rescaleVelocities(double ratio);
+void setStepSize(double delta_t);
+int totalParticles();
+void wake();
+void collide(Hair *hair);
+bool colliderMoved(Hair *hair);
+void setSolver(StrandSolver *new_solver);
+StrandSolver *solverNamed(const string &name);
+double uniform();
+void updateLOD(Vector3D view_pos);
+int lodParticles(Hair *hair, int level);
 
 vector<Hair*> * hair_vector;
-int num_hairs;
+int num_hairs = 0;
 int particles_count;
 double length;
 double damping;
@@ -37,19 +63,68 @@ bool enable_core_constraints = true;
 
 double density;
 
+// simulated time, drives the root animation
+double time = 0;
+long frame = 0;
+
+// substep the Verlet velocities were last taken over, 0 before the first step
+double delta_t = 0;
+
+// all randomness of the groom, so checkpoints can restore it
+mt19937 rng;
+RootAnimation *root_animation = nullptr;
+
+ForceFields *force_fields = nullptr;
+
+// strand model, the mass spring solver if not set
+StrandSolver *solver = nullptr;
+// every solver set so far, kept with its state for switching back
+vector<StrandSolver *> solvers;
+
+// density and velocity grid for volume, velocity smoothing and shadows
+HairGrid *volume = nullptr;
+
+// scene colliders, shared with the cloth and owned by the simulator
+vector<CollisionObject *> *collision_objects = nullptr;
+CollisionBVH *collision_bvh = nullptr; // refit once a frame
+long collision_frame = -1;
+
+// sleeping; a strand wakes when its root moves, the external accelerations
+// change or a collider that moved this frame comes near it
+bool enable_sleep = false;
+double sleep_energy = 1e-4; // kinetic energy per unit mass
+int sleep_steps = 30;
+Vector3D last_total_accel;
+
+// level of detail
+bool enable_lod = false;
+double lod_distance = 100.0; // full resolution up to this distance
+int min_lod_particles = 3;
+int particle_budget = 0;     // 0 for no budget
+
+// coarse levels of strain limiting before the per segment pass, level l
+// clamps the chords between every 2^l-th particle
+int projection_levels = 0;
+
+// keep every particle within its rest length along the strand from the root
+bool enable_tethers = false;
+
 // stretch springs
-double cs;
+double cs = 0;
 double ks;
 
 // bend springs
 double ab; // bend smoothing amount
-double cb;
+double cb = 0;
 double kb;
 
 // core springs
 double ac; // core smoothing amount
-double cc;
+double cc = 0;
 double kc;
+
+// air drag per unit length on the velocity normal to each segment
+double drag = 0;
 };
 
 #endif //CLOTHSIM_HAIRVECTOR_H
@@ -0,0 +1,130 @@
+#include "bandedSolver.h"
+
+// Rows are eliminated one after another; the inner loops run over the
+// systems, which are independent and contiguous.
+
+void solveTridiagonal(int n, int count, const double *lower, const double *diag,
+                      const double *upper, double *rhs, double *scratch) {
+  for (int s = 0; s < count; s++) {
+    scratch[s] = upper[s] / diag[s];
+    rhs[s] /= diag[s];
+  }
+  for (int i = 1; i < n; i++) {
+    const double *l = lower + i * count, *d = diag + i * count, *u = upper + i * count;
+    double *c = scratch + i * count, *c_prev = c - count;
+    double *r = rhs + i * count, *r_prev = r - count;
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      double inv = 1.0 / (d[s] - l[s] * c_prev[s]);
+      c[s] = u[s] * inv;
+      r[s] = (r[s] - l[s] * r_prev[s]) * inv;
+    }
+  }
+  for (int i = n - 2; i >= 0; i--) {
+    const double *c = scratch + i * count;
+    double *r = rhs + i * count, *r_next = r + count;
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      r[s] -= c[s] * r_next[s];
+    }
+  }
+}
+
+void solveSymmetricTridiagonal(int n, int count, double *diag, double *off, double *rhs) {
+  for (int i = 1; i < n; i++) {
+    double *d = diag + i * count, *d_prev = d - count;
+    double *o_prev = off + (i - 1) * count;
+    double *r = rhs + i * count, *r_prev = r - count;
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      double l = o_prev[s] / d_prev[s];
+      d[s] -= l * o_prev[s];
+      o_prev[s] = l;
+      r[s] -= l * r_prev[s];
+    }
+  }
+  double *last = rhs + (n - 1) * count;
+  for (int s = 0; s < count; s++) {
+    last[s] /= diag[(n - 1) * count + s];
+  }
+  for (int i = n - 2; i >= 0; i--) {
+    const double *d = diag + i * count, *o = off + i * count;
+    double *r = rhs + i * count, *r_next = r + count;
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      r[s] = r[s] / d[s] - o[s] * r_next[s];
+    }
+  }
+}
+
+void factorPentadiagonal(int n, int count, double *a, double *b, double *c) {
+  if (n > 1) {
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      double l1 = b[s] / a[s];
+      a[count + s] -= l1 * l1 * a[s];
+      b[s] = l1;
+    }
+  }
+  for (int i = 2; i < n; i++) {
+    double *a_i = a + i * count, *a_1 = a_i - count, *a_2 = a_1 - count;
+    double *b_1 = b + (i - 1) * count, *b_2 = b_1 - count;
+    double *c_2 = c + (i - 2) * count;
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      double l2 = c_2[s] / a_2[s];
+      double l1 = (b_1[s] - l2 * a_2[s] * b_2[s]) / a_1[s];
+      a_i[s] -= l1 * l1 * a_1[s] + l2 * l2 * a_2[s];
+      c_2[s] = l2;
+      b_1[s] = l1;
+    }
+  }
+}
+
+void solvePentadiagonal(int n, int count, const double *a, const double *b, const double *c,
+                        double *x, double *y, double *z) {
+  for (int i = 1; i < n; i++) {
+    int row = i * count;
+    const double *b_1 = b + row - count;
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      x[row + s] -= b_1[s] * x[row - count + s];
+      y[row + s] -= b_1[s] * y[row - count + s];
+      z[row + s] -= b_1[s] * z[row - count + s];
+    }
+    if (i < 2) continue;
+    const double *c_2 = c + row - 2 * count;
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      x[row + s] -= c_2[s] * x[row - 2 * count + s];
+      y[row + s] -= c_2[s] * y[row - 2 * count + s];
+      z[row + s] -= c_2[s] * z[row - 2 * count + s];
+    }
+  }
+  for (int i = n - 1; i >= 0; i--) {
+    int row = i * count;
+#pragma omp simd
+    for (int s = 0; s < count; s++) {
+      double inv = 1.0 / a[row + s];
+      x[row + s] *= inv;
+      y[row + s] *= inv;
+      z[row + s] *= inv;
+    }
+    if (i + 1 < n) {
+#pragma omp simd
+      for (int s = 0; s < count; s++) {
+        x[row + s] -= b[row + s] * x[row + count + s];
+        y[row + s] -= b[row + s] * y[row + count + s];
+        z[row + s] -= b[row + s] * z[row + count + s];
+      }
+    }
+    if (i + 2 < n) {
+#pragma omp simd
+      for (int s = 0; s < count; s++) {
+        x[row + s] -= c[row + s] * x[row + 2 * count + s];
+        y[row + s] -= c[row + s] * y[row + 2 * count + s];
+        z[row + s] -= c[row + s] * z[row + 2 * count + s];
+      }
+    }
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef CLOTHSIM_BANDEDSOLVER_H
+#define CLOTHSIM_BANDEDSOLVER_H
+
+/**
+ * Direct solvers for many independent banded systems of the same size, as
+ * they come out of strands: a chain of n particles couples each one to its
+ * neighbours (tridiagonal) or to the neighbours of its neighbours
+ * (pentadiagonal).
+ *
+ * The systems are stored interleaved: entry i of system s is at
+ * i * count + s. Every step of the elimination then runs over all systems
+ * with unit stride, which vectorizes, instead of walking one short strand
+ * after another. With count == 1 this is plain contiguous storage.
+ *
+ * No pivoting is done, the matrices have to be diagonally dominant or
+ * symmetric positive definite, which mass plus stiffness terms are.
+ */
+
+// Thomas algorithm for general tridiagonal systems. lower[i] couples i to
+// i - 1 (lower of row 0 is unused), upper[i] couples i to i + 1. rhs
+// receives the solution, scratch holds n * count doubles.
+void solveTridiagonal(int n, int count, const double *lower, const double *diag,
+                      const double *upper, double *rhs, double *scratch);
+
+// Symmetric tridiagonal systems in place with an LDL^T factorization.
+// diag and off (off[i] couples i and i + 1) are overwritten, rhs receives
+// the solution.
+void solveSymmetricTridiagonal(int n, int count, double *diag, double *off, double *rhs);
+
+// LDL^T factorization of symmetric pentadiagonal matrices in place: a is
+// the diagonal, b[i] couples i and i + 1, c[i] couples i and i + 2.
+void factorPentadiagonal(int n, int count, double *a, double *b, double *c);
+
+// Forward and back substitution with the factors, for the three
+// coordinates at once.
+void solvePentadiagonal(int n, int count, const double *a, const double *b, const double *c,
+                        double *x, double *y, double *z);
+
+#endif //CLOTHSIM_BANDEDSOLVER_H
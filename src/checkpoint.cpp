@@ -0,0 +1,401 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "checkpoint.h"
+#include "forceField.h"
+#include "strandSolver.h"
+
+using namespace std;
+
+static const char CHECKPOINT_MAGIC[8] = {'H', 'A', 'I', 'R', 'C', 'K', 'P', 'T'};
+static const uint32_t CHECKPOINT_VERSION = 4;
+
+enum e_checkpoint_flags {
+  STRETCH_FLAG = 1 << 0,
+  SUPPORT_FLAG = 1 << 1,
+  BENDING_FLAG = 1 << 2,
+  CORE_FLAG = 1 << 3,
+  SLEEP_FLAG = 1 << 4,
+  LOD_FLAG = 1 << 5,
+  TETHERS_FLAG = 1 << 6
+};
+
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_strands;
+  int64_t frame;
+  double time;
+  double delta_t; // substep of the Verlet velocities
+  double last_total_accel[3];
+  char solver[32];
+  uint32_t rng_size;
+  uint32_t flags;
+
+  int32_t num_hairs;
+  int32_t particles_count;
+  double length;
+  double damping;
+  double density;
+  double cs, ks;
+  double ab, cb, kb;
+  double ac, cc, kc;
+  double drag;
+  int32_t projection_levels;
+
+  double sleep_energy;
+  int32_t sleep_steps;
+  int32_t min_lod_particles;
+  double lod_distance;
+  int64_t particle_budget;
+
+  // Placement of the turbulence cache, which is rebuilt from it
+  uint32_t turbulence_built;
+  int32_t turbulence_size[3];
+  double turbulence_refresh;
+  double turbulence_min[3];
+  double turbulence_cell;
+};
+
+struct StrandHeader {
+  uint32_t particles;
+  uint32_t full_particles;
+  int32_t lod_level;
+  int32_t still_steps;
+  uint32_t asleep;
+  uint32_t solver_size; // doubles
+  double length;
+  double avg_spring_length;
+};
+
+// Doubles stored per particle besides the solver state
+static const int PARTICLE_DOUBLES = 13;
+
+template <typename T>
+static void put(vector<char> &buffer, const T &value) {
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void put(vector<char> &buffer, const Vector3D &v) {
+  put(buffer, v.x);
+  put(buffer, v.y);
+  put(buffer, v.z);
+}
+
+bool saveCheckpoint(const string &filename, HairVector *hairs) {
+  if (!hairs->solver) {
+    hairs->setSolver(hairs->solverNamed("mass spring"));
+  }
+
+  ostringstream rng_state;
+  rng_state << hairs->rng;
+  string rng = rng_state.str();
+
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.num_strands = hairs->hair_vector->size();
+  header.frame = hairs->frame;
+  header.time = hairs->time;
+  header.delta_t = hairs->delta_t;
+  header.last_total_accel[0] = hairs->last_total_accel.x;
+  header.last_total_accel[1] = hairs->last_total_accel.y;
+  header.last_total_accel[2] = hairs->last_total_accel.z;
+  strncpy(header.solver, hairs->solver->name().c_str(), sizeof(header.solver) - 1);
+  header.rng_size = rng.size();
+  header.flags = (hairs->enable_stretch_constraints ? STRETCH_FLAG : 0) |
+                 (hairs->enable_support_constraints ? SUPPORT_FLAG : 0) |
+                 (hairs->enable_bending_constraints ? BENDING_FLAG : 0) |
+                 (hairs->enable_core_constraints ? CORE_FLAG : 0) |
+                 (hairs->enable_sleep ? SLEEP_FLAG : 0) |
+                 (hairs->enable_lod ? LOD_FLAG : 0) |
+                 (hairs->enable_tethers ? TETHERS_FLAG : 0);
+  header.num_hairs = hairs->num_hairs;
+  header.particles_count = hairs->particles_count;
+  header.length = hairs->length;
+  header.damping = hairs->damping;
+  header.density = hairs->density;
+  header.cs = hairs->cs;
+  header.ks = hairs->ks;
+  header.ab = hairs->ab;
+  header.cb = hairs->cb;
+  header.kb = hairs->kb;
+  header.ac = hairs->ac;
+  header.cc = hairs->cc;
+  header.kc = hairs->kc;
+  header.drag = hairs->drag;
+  header.projection_levels = hairs->projection_levels;
+  header.sleep_energy = hairs->sleep_energy;
+  header.sleep_steps = hairs->sleep_steps;
+  header.min_lod_particles = hairs->min_lod_particles;
+  header.lod_distance = hairs->lod_distance;
+  header.particle_budget = hairs->particle_budget;
+  if (hairs->force_fields) {
+    Vector3D min;
+    header.turbulence_built = hairs->force_fields->cacheState(
+        header.turbulence_refresh, min, header.turbulence_cell, header.turbulence_size);
+    header.turbulence_min[0] = min.x;
+    header.turbulence_min[1] = min.y;
+    header.turbulence_min[2] = min.z;
+  }
+
+  vector<char> buffer;
+  put(buffer, header);
+  buffer.insert(buffer.end(), rng.begin(), rng.end());
+
+  vector<double> state;
+  for (int s = 0; s < header.num_strands; s++) {
+    Hair *hair = (*hairs->hair_vector)[s];
+
+    state.clear();
+    hairs->solver->exportState(hair, s, state);
+
+    StrandHeader strand;
+    memset(&strand, 0, sizeof(strand));
+    strand.particles = hair->point_masses.size();
+    strand.full_particles = hair->full_start_positions.size();
+    strand.lod_level = hair->lod_level;
+    strand.still_steps = hair->still_steps;
+    strand.asleep = hair->asleep;
+    strand.solver_size = state.size();
+    strand.length = hair->length;
+    strand.avg_spring_length = hair->avg_spring_length;
+    put(buffer, strand);
+
+    for (Vector3D &p : hair->full_start_positions) {
+      put(buffer, p);
+    }
+    for (PointMass &pm : hair->point_masses) {
+      put(buffer, pm.pinned ? 1.0 : 0.0);
+      put(buffer, pm.start_position);
+      put(buffer, pm.smoothed_position);
+      put(buffer, pm.smoothed_velocity);
+      put(buffer, pm.smoothing_amt);
+    }
+    const char *bytes = reinterpret_cast<const char *>(state.data());
+    buffer.insert(buffer.end(), bytes, bytes + state.size() * sizeof(double));
+  }
+
+  ofstream o(filename, ios::binary);
+  if (!o.good()) {
+    cout << "Could not write checkpoint " << filename << endl;
+    return false;
+  }
+  o.write(buffer.data(), buffer.size());
+  return o.good();
+}
+
+// Bounds checked reads out of the mapped file
+struct CheckpointReader {
+  const char *p;
+  const char *end;
+  bool truncated = false;
+
+  bool read(void *dst, size_t size) {
+    if (size > (size_t) (end - p)) {
+      truncated = true;
+      return false;
+    }
+    memcpy(dst, p, size);
+    p += size;
+    return true;
+  }
+
+  bool readDoubles(double *dst, size_t count) {
+    return read(dst, count * sizeof(double));
+  }
+
+  // Whether count items of size bytes are left, checked before allocating
+  // for counts that come from the file
+  bool fits(size_t count, size_t size) {
+    if (count > (size_t) (end - p) / size) {
+      truncated = true;
+      return false;
+    }
+    return true;
+  }
+};
+
+static Hair *readStrand(CheckpointReader &in, StrandSolver *solver, vector<double> &state) {
+  StrandHeader strand;
+  if (!in.read(&strand, sizeof(strand))) return nullptr;
+  // The importer reads as much as the solver exports, whatever the file says
+  size_t expected = solver->stateSize(strand.particles);
+  if (strand.solver_size != expected) {
+    cout << "Checkpoint strand of " << strand.particles << " particles has " << strand.solver_size
+         << " doubles of " << solver->name() << " state, expected " << expected << endl;
+    return nullptr;
+  }
+  size_t doubles = (size_t) strand.full_particles * 3 + (size_t) strand.particles * PARTICLE_DOUBLES +
+                   strand.solver_size;
+  if (!in.fits(doubles, sizeof(double))) return nullptr;
+
+  Hair *hair = new Hair(strand.particles, strand.length);
+  hair->avg_spring_length = strand.avg_spring_length;
+  hair->lod_level = strand.lod_level;
+  hair->still_steps = strand.still_steps;
+  hair->asleep = strand.asleep;
+
+  double values[PARTICLE_DOUBLES];
+  hair->full_start_positions.resize(strand.full_particles);
+  for (Vector3D &p : hair->full_start_positions) {
+    if (!in.readDoubles(values, 3)) break;
+    p = Vector3D(values[0], values[1], values[2]);
+  }
+
+  hair->point_masses.reserve(strand.particles);
+  for (int i = 0; i < strand.particles && !in.truncated; i++) {
+    if (!in.readDoubles(values, PARTICLE_DOUBLES)) break;
+    PointMass pm(Vector3D(values[1], values[2], values[3]), values[0] != 0.0);
+    pm.smoothed_position = Vector3D(values[4], values[5], values[6]);
+    pm.smoothed_velocity = Vector3D(values[7], values[8], values[9]);
+    pm.smoothing_amt = Vector3D(values[10], values[11], values[12]);
+    hair->point_masses.push_back(pm);
+  }
+
+  state.resize(strand.solver_size);
+  if (in.truncated || !in.readDoubles(state.data(), state.size())) {
+    delete hair;
+    return nullptr;
+  }
+
+  hair->buildSprings();
+  return hair;
+}
+
+// Reads everything before touching hairs, so a bad file leaves the
+// simulation as it was
+static bool restore(CheckpointReader &in, HairVector *hairs, const string &filename) {
+  CheckpointHeader header;
+  if (!in.read(&header, sizeof(header))) return false;
+  if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+    cout << filename << " is not a hair checkpoint" << endl;
+    return false;
+  }
+  if (header.version != CHECKPOINT_VERSION) {
+    cout << "Checkpoint " << filename << " has version " << header.version
+         << ", expected " << CHECKPOINT_VERSION << endl;
+    return false;
+  }
+
+  // Counts from the file are checked against its size before allocating
+  if (!in.fits(header.rng_size, 1)) return false;
+  string rng(header.rng_size, '\0');
+  if (!in.read(&rng[0], rng.size())) return false;
+  if (!in.fits(header.num_strands, sizeof(StrandHeader))) return false;
+
+  header.solver[sizeof(header.solver) - 1] = '\0';
+  string solver_name = header.solver;
+  StrandSolver *solver = hairs->solverNamed(solver_name);
+  if (!solver) {
+    cout << "Checkpoint " << filename << " uses unknown solver " << solver_name << endl;
+    return false;
+  }
+
+  vector<Hair *> strands;
+  vector<vector<double>> states(header.num_strands);
+  for (int s = 0; s < header.num_strands; s++) {
+    Hair *hair = readStrand(in, solver, states[s]);
+    if (!hair) {
+      for (Hair *h : strands) delete h;
+      return false;
+    }
+    strands.push_back(hair);
+  }
+
+  for (Hair *hair : *hairs->hair_vector) {
+    delete hair;
+  }
+  *hairs->hair_vector = strands;
+
+  istringstream rng_state(rng);
+  rng_state >> hairs->rng;
+
+  hairs->frame = header.frame;
+  hairs->time = header.time;
+  hairs->delta_t = header.delta_t;
+  hairs->last_total_accel = Vector3D(header.last_total_accel[0], header.last_total_accel[1],
+                                     header.last_total_accel[2]);
+  hairs->enable_stretch_constraints = header.flags & STRETCH_FLAG;
+  hairs->enable_support_constraints = header.flags & SUPPORT_FLAG;
+  hairs->enable_bending_constraints = header.flags & BENDING_FLAG;
+  hairs->enable_core_constraints = header.flags & CORE_FLAG;
+  hairs->enable_sleep = header.flags & SLEEP_FLAG;
+  hairs->enable_lod = header.flags & LOD_FLAG;
+  hairs->enable_tethers = header.flags & TETHERS_FLAG;
+  hairs->num_hairs = header.num_hairs;
+  hairs->particles_count = header.particles_count;
+  hairs->length = header.length;
+  hairs->damping = header.damping;
+  hairs->density = header.density;
+  hairs->cs = header.cs;
+  hairs->ks = header.ks;
+  hairs->ab = header.ab;
+  hairs->cb = header.cb;
+  hairs->kb = header.kb;
+  hairs->ac = header.ac;
+  hairs->cc = header.cc;
+  hairs->kc = header.kc;
+  hairs->drag = header.drag;
+  hairs->projection_levels = header.projection_levels;
+  hairs->sleep_energy = header.sleep_energy;
+  hairs->sleep_steps = header.sleep_steps;
+  hairs->min_lod_particles = header.min_lod_particles;
+  hairs->lod_distance = header.lod_distance;
+  hairs->particle_budget = header.particle_budget;
+  if (hairs->force_fields) {
+    hairs->force_fields->restoreCache(
+        header.turbulence_built, header.turbulence_refresh,
+        Vector3D(header.turbulence_min[0], header.turbulence_min[1], header.turbulence_min[2]),
+        header.turbulence_cell, header.turbulence_size);
+  }
+
+  hairs->setSolver(solver);
+  for (int s = 0; s < header.num_strands; s++) {
+    solver->importState(strands[s], s, states[s], 0);
+  }
+  return true;
+}
+
+bool loadCheckpoint(const string &filename, HairVector *hairs) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    cout << "Could not open checkpoint " << filename << endl;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    cout << "Could not read checkpoint " << filename << endl;
+    return false;
+  }
+
+  void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    cout << "Could not map checkpoint " << filename << endl;
+    return false;
+  }
+
+  CheckpointReader in;
+  in.p = static_cast<const char *>(data);
+  in.end = in.p + info.st_size;
+  bool ok = restore(in, hairs, filename);
+  munmap(data, info.st_size);
+
+  if (in.truncated) {
+    cout << "Checkpoint " << filename << " is truncated" << endl;
+  }
+  return ok;
+}
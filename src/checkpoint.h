@@ -0,0 +1,29 @@
+#ifndef CLOTHSIM_CHECKPOINT_H
+#define CLOTHSIM_CHECKPOINT_H
+
+#include <string>
+
+#include "HairVector.h"
+
+using namespace std;
+
+/**
+ * Binary snapshot of the whole hair simulation: the groom and solver
+ * parameters, the random number generator, the frame counter, time and
+ * substep size, and per strand the rest shape, the Verlet state, the
+ * smoothing state and whatever the strand solver keeps on top of it.
+ *
+ * The file is a fixed header followed by the strands back to back, in the
+ * byte order of the machine that wrote it. Loading maps the file and copies
+ * straight out of the mapping.
+ *
+ * Restoring replaces the strands and parameters of hairs. Objects that come
+ * from the scene file (force fields, volume grid, root animation) are kept,
+ * with the turbulence cache rebuilt where and as of when it was saved.
+ * The velocities stay those of the saved substep; the next step at another
+ * substep size rescales them (HairVector::setStepSize).
+ */
+bool saveCheckpoint(const string &filename, HairVector *hairs);
+bool loadCheckpoint(const string &filename, HairVector *hairs);
+
+#endif //CLOTHSIM_CHECKPOINT_H
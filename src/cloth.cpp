@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <iostream>
 #include <math.h>
 #include <random>
+#include <stdint.h>
 #include <vector>
 
 #include "cloth.h"
@@ -31,8 +33,174 @@ Cloth::~Cloth() {
 }
 
 void Cloth::buildGrid() {
-  // TODO (Part 1): Build a grid of masses and springs.
+  point_masses.clear();
+  point_masses.reserve(num_width_points * num_height_points);
+
+  // Vertical cloth gets a tiny random depth so it does not fold in a plane
+  mt19937 rng(0);
+  uniform_real_distribution<double> offset(-1.0 / 1000.0, 1.0 / 1000.0);
+
+  for (int y = 0; y < num_height_points; y++) {
+    for (int x = 0; x < num_width_points; x++) {
+      double u = width * x / (num_width_points - 1);
+      double v = height * y / (num_height_points - 1);
+      Vector3D position = orientation == HORIZONTAL ? Vector3D(u, 1.0, v)
+                                                    : Vector3D(u, v, offset(rng));
+      point_masses.push_back(PointMass(position, false));
+    }
+  }
+
+  for (vector<int> &xy : pinned) {
+    point_masses[xy[1] * num_width_points + xy[0]].pinned = true;
+  }
+
+  springs.assign(3, ClothSprings());
+  springs[STRUCTURAL].type = STRUCTURAL;
+  springs[SHEARING].type = SHEARING;
+  springs[BENDING].type = BENDING;
+
+  // One direction at a time, each spring pointing further along in memory,
+  // which leaves the sets sorted and every row (or the whole grid, for the
+  // vertical directions) one run
+  auto connect = [&](e_spring_type type, int dx, int dy) {
+    ClothSprings &set = springs[type];
+    for (int y = 0; y + dy < num_height_points; y++) {
+      for (int x = max(0, -dx); x < num_width_points && x + dx < num_width_points; x++) {
+        int a = y * num_width_points + x;
+        int b = (y + dy) * num_width_points + x + dx;
+        int last = set.pm_a.size() - 1;
+        if (last < 0 || a != set.pm_a[last] + 1 || b - a != set.pm_b[last] - set.pm_a[last]) {
+          set.runs.push_back(set.pm_a.size());
+        }
+        set.pm_a.push_back(a);
+        set.pm_b.push_back(b);
+        set.rest_length.push_back((point_masses[a].position - point_masses[b].position).norm());
+      }
+    }
+  };
+
+  connect(STRUCTURAL, 1, 0);
+  connect(STRUCTURAL, 0, 1);
+  connect(SHEARING, 1, 1);
+  connect(SHEARING, -1, 1);
+  connect(BENDING, 2, 0);
+  connect(BENDING, 0, 2);
+
+  for (ClothSprings &set : springs) {
+    set.runs.push_back(set.pm_a.size());
+    colorSprings(set);
+  }
+}
+
+void Cloth::colorSprings(ClothSprings &set) {
+  int count = set.pm_a.size();
+  vector<uint64_t> used(point_masses.size(), 0);
+  vector<int> color(count);
+  int num_colors = 0;
+
+  // Greedy, in the sorted order: each spring takes the lowest color neither
+  // of its particles has yet. A grid direction alternates between two
+  // colors, so a set ends up with two per direction it contains at most.
+  for (int k = 0; k < count; k++) {
+    uint64_t taken = used[set.pm_a[k]] | used[set.pm_b[k]];
+    int c = 0;
+    while (taken & (1ull << c)) c++;
+    color[k] = c;
+    used[set.pm_a[k]] |= 1ull << c;
+    used[set.pm_b[k]] |= 1ull << c;
+    num_colors = max(num_colors, c + 1);
+  }
+
+  set.colors.assign(num_colors + 1, 0);
+  for (int k = 0; k < count; k++) {
+    set.colors[color[k] + 1]++;
+  }
+  for (int c = 0; c < num_colors; c++) {
+    set.colors[c + 1] += set.colors[c];
+  }
+
+  vector<int> next(set.colors.begin(), set.colors.end() - 1);
+  set.color_order.resize(count);
+  for (int k = 0; k < count; k++) {
+    set.color_order[next[color[k]]++] = k;
+  }
+}
+
+void Cloth::springForces(ClothSprings &set, double ks) {
+  int count = set.pm_a.size();
+  spring_x.resize(count);
+  spring_y.resize(count);
+  spring_z.resize(count);
+
+  // Within a run both ends of the springs are contiguous, so every loop
+  // below is unit stride and vectorizes without gathers. The forces are
+  // accumulated in separate passes for the two ends, since with an offset of
+  // one particle they would overlap within a vector.
+  for (int r = 0; r + 1 < set.runs.size(); r++) {
+    int start = set.runs[r], length = set.runs[r + 1] - start;
+    int a = set.pm_a[start], offset = set.pm_b[start] - a;
+
+    const double *px = &pos_x[a], *py = &pos_y[a], *pz = &pos_z[a];
+    const double *rest = &set.rest_length[start];
+    double *sx = &spring_x[start], *sy = &spring_y[start], *sz = &spring_z[start];
+#pragma omp simd
+    for (int k = 0; k < length; k++) {
+      double dx = px[k + offset] - px[k];
+      double dy = py[k + offset] - py[k];
+      double dz = pz[k + offset] - pz[k];
+      double f = ks * (1.0 - rest[k] / sqrt(dx * dx + dy * dy + dz * dz));
+      sx[k] = f * dx;
+      sy[k] = f * dy;
+      sz[k] = f * dz;
+    }
 
+    double *fx = &force_x[a], *fy = &force_y[a], *fz = &force_z[a];
+#pragma omp simd
+    for (int k = 0; k < length; k++) {
+      fx[k] += sx[k];
+      fy[k] += sy[k];
+      fz[k] += sz[k];
+    }
+    fx += offset;
+    fy += offset;
+    fz += offset;
+#pragma omp simd
+    for (int k = 0; k < length; k++) {
+      fx[k] -= sx[k];
+      fy[k] -= sy[k];
+      fz[k] -= sz[k];
+    }
+  }
+}
+
+void Cloth::limitStrain(ClothSprings &set) {
+  // The springs of one color touch disjoint particles, so each color is
+  // projected in parallel and the colors one after another
+#pragma omp parallel
+  for (int c = 0; c + 1 < set.colors.size(); c++) {
+#pragma omp for
+    for (int i = set.colors[c]; i < set.colors[c + 1]; i++) {
+      int k = set.color_order[i];
+      PointMass &pm_a = point_masses[set.pm_a[k]];
+      PointMass &pm_b = point_masses[set.pm_b[k]];
+      if (pm_a.pinned && pm_b.pinned) continue;
+
+      Vector3D d = pm_b.position - pm_a.position;
+      double length = d.norm();
+      double limit = set.rest_length[k] * 1.1;
+      if (length <= limit) continue;
+
+      Vector3D correction = d * ((length - limit) / length);
+      if (pm_a.pinned) {
+        pm_b.position -= correction;
+      } else if (pm_b.pinned) {
+        pm_a.position += correction;
+      } else {
+        pm_a.position += correction / 2.0;
+        pm_b.position -= correction / 2.0;
+      }
+    }
+  }
 }
 
 void Cloth::simulate(double frames_per_sec, double simulation_steps, ClothParameters *cp,
@@ -41,33 +209,157 @@ void Cloth::simulate(double frames_per_sec, double simulation_steps, ClothParame
   double mass = width * height * cp->density / num_width_points / num_height_points;
   double delta_t = 1.0f / frames_per_sec / simulation_steps;
 
-  // TODO (Part 2): Compute total force acting on each point mass.
-
+  int n = point_masses.size();
+  bool enabled[] = {cp->enable_structural_constraints, cp->enable_shearing_constraints,
+                    cp->enable_bending_constraints};
 
-  // TODO (Part 2): Use Verlet integration to compute new point mass positions
+  Vector3D external;
+  for (Vector3D &accel : external_accelerations) {
+    external += mass * accel;
+  }
 
+  pos_x.resize(n);
+  pos_y.resize(n);
+  pos_z.resize(n);
+  for (int i = 0; i < n; i++) {
+    pos_x[i] = point_masses[i].position.x;
+    pos_y[i] = point_masses[i].position.y;
+    pos_z[i] = point_masses[i].position.z;
+  }
+  force_x.assign(n, external.x);
+  force_y.assign(n, external.y);
+  force_z.assign(n, external.z);
+
+  // Bending springs are softer so the cloth can still fold
+  for (ClothSprings &set : springs) {
+    if (enabled[set.type]) {
+      springForces(set, set.type == BENDING ? cp->ks * 0.2 : cp->ks);
+    }
+  }
 
+  for (int i = 0; i < n; i++) {
+    PointMass &pm = point_masses[i];
+    pm.forces = Vector3D(force_x[i], force_y[i], force_z[i]);
+    if (!pm.pinned) {
+      Vector3D temp = pm.position;
+      pm.position += (1.0 - cp->damping / 100.0) * (pm.position - pm.last_position) +
+                     (pm.forces / mass) * (delta_t * delta_t);   // Verlet Integration
+      pm.last_position = temp;
+    }
+  }
 
-  // TODO (Part 4): Handle self-collisions.
-  // This won't do anything until you complete Part 4.
   build_spatial_map();
   for (PointMass &pm : point_masses) {
     self_collide(pm, simulation_steps);
   }
 
 
-  // TODO (Part 3): Handle collisions with other primitives.
-  // This won't do anything until you complete Part 3.
-  for (PointMass &pm : point_masses) {
-    for (CollisionObject *co : *collision_objects) {
-      co->collide(pm);
+  collide(collision_objects, simulation_steps);
+
+
+  // Springs may not be more than 10% longer than at rest [Provot 1995]
+  for (ClothSprings &set : springs) {
+    if (enabled[set.type]) {
+      limitStrain(set);
     }
   }
+}
+
+// Particles tested against the colliders near them at once
+static const int COLLISION_BATCH = 32;
 
+void Cloth::collide(vector<CollisionObject *> *collision_objects, double simulation_steps) {
+  if (collision_objects->empty()) return;
+
+  // Refit and reorder once a frame, neither the colliders nor the cloth
+  // move much further in between
+  bool new_frame = collision_order.size() != point_masses.size() ||
+                   ++steps_since_sort >= simulation_steps;
+  collision_bvh.update(*collision_objects, new_frame);
+  if (new_frame) {
+    sortByMortonCode();
+  }
+
+  vector<CollisionObject *> candidates;
+  int n = collision_order.size();
+  for (int begin = 0; begin < n; begin += COLLISION_BATCH) {
+    int end = min(n, begin + COLLISION_BATCH);
+
+    // Box around the whole step of every particle in the batch
+    Vector3D lo = point_masses[collision_order[begin]].position, hi = lo;
+    for (int i = begin; i < end; i++) {
+      PointMass &pm = point_masses[collision_order[i]];
+      for (int k = 0; k < 3; k++) {
+        lo[k] = min(lo[k], min(pm.position[k], pm.last_position[k]));
+        hi[k] = max(hi[k], max(pm.position[k], pm.last_position[k]));
+      }
+    }
 
-  // TODO (Part 2): Constrain the changes to be such that the spring does not change
-  // in length more than 10% per timestep [Provot 1995].
+    candidates.clear();
+    collision_bvh.query(lo, hi, candidates);
+    if (candidates.empty()) continue;
+
+    int count = end - begin;
+    double x[COLLISION_BATCH], y[COLLISION_BATCH], z[COLLISION_BATCH];
+    double motion[COLLISION_BATCH], distance[COLLISION_BATCH];
+    for (CollisionObject *co : candidates) {
+      for (int i = 0; i < count; i++) {
+        PointMass &pm = point_masses[collision_order[begin + i]];
+        x[i] = pm.position.x;
+        y[i] = pm.position.y;
+        z[i] = pm.position.z;
+        motion[i] = (pm.position - pm.last_position).norm();
+      }
+
+      // A particle further from the surface than it moved can neither be
+      // inside nor have passed through
+      co->distances(x, y, z, count, distance);
+      for (int i = 0; i < count; i++) {
+        if (distance[i] <= motion[i]) {
+          co->collide(point_masses[collision_order[begin + i]]);
+        }
+      }
+    }
+  }
+}
 
+static uint32_t spreadBits(uint32_t x) {
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8)) & 0x0300f00f;
+  x = (x | (x << 4)) & 0x030c30c3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+void Cloth::sortByMortonCode() {
+  steps_since_sort = 0;
+
+  int n = point_masses.size();
+  Vector3D lo = point_masses[0].position, hi = lo;
+  for (PointMass &pm : point_masses) {
+    for (int k = 0; k < 3; k++) {
+      lo[k] = min(lo[k], pm.position[k]);
+      hi[k] = max(hi[k], pm.position[k]);
+    }
+  }
+
+  // 10 bits per axis over the bounds of the cloth
+  vector<pair<uint32_t, int>> keys(n);
+  for (int i = 0; i < n; i++) {
+    uint32_t code = 0;
+    for (int k = 0; k < 3; k++) {
+      double extent = hi[k] - lo[k];
+      double u = extent > 0 ? (point_masses[i].position[k] - lo[k]) / extent : 0;
+      code |= spreadBits(min(1023u, (uint32_t) (u * 1024))) << k;
+    }
+    keys[i] = make_pair(code, i);
+  }
+  sort(keys.begin(), keys.end());
+
+  collision_order.resize(n);
+  for (int i = 0; i < n; i++) {
+    collision_order[i] = keys[i].second;
+  }
 }
 
 void Cloth::build_spatial_map() {
@@ -76,20 +368,51 @@ void Cloth::build_spatial_map() {
   }
   map.clear();
 
-  // TODO (Part 4): Build a spatial map out of all of the point masses.
-
+  for (PointMass &pm : point_masses) {
+    float key = hash_position(pm.position);
+    auto it = map.find(key);
+    if (it == map.end()) {
+      it = map.insert({key, new vector<PointMass *>()}).first;
+    }
+    it->second->push_back(&pm);
+  }
 }
 
 void Cloth::self_collide(PointMass &pm, double simulation_steps) {
-  // TODO (Part 4): Handle self-collision for a given point mass.
-
+  if (pm.pinned) return;
+
+  auto it = map.find(hash_position(pm.position));
+  if (it == map.end()) return;
+
+  // Push away from every particle closer than twice the thickness, by the
+  // average correction spread over the substeps of a frame
+  Vector3D correction;
+  int count = 0;
+  for (PointMass *other : *it->second) {
+    if (other == &pm) continue;
+    Vector3D d = pm.position - other->position;
+    double distance = d.norm();
+    if (distance < 2.0 * thickness && distance > 0) {
+      correction += d * ((2.0 * thickness - distance) / distance);
+      count++;
+    }
+  }
+  if (count > 0) {
+    pm.position += correction / count / simulation_steps;
+  }
 }
 
 float Cloth::hash_position(Vector3D pos) {
-  // TODO (Part 4): Hash a 3D position into a unique float identifier that represents
-  // membership in some uniquely identified 3D box volume.
-
-  return 0.f;
+  // Boxes of three particle spacings, so neighbours within reach mostly
+  // share a box
+  double w = 3.0 * width / num_width_points;
+  double h = 3.0 * height / num_height_points;
+  double t = max(w, h);
+
+  int x = (int) floor(pos.x / w);
+  int y = (int) floor(pos.y / h);
+  int z = (int) floor(pos.z / t);
+  return (float) ((x * 1009 + y) * 1009 + z);
 }
 
 ///////////////////////////////////////////////////////
@@ -108,115 +431,29 @@ void Cloth::reset() {
 void Cloth::buildClothMesh() {
   if (point_masses.size() == 0) return;
 
-  ClothMesh *clothMesh = new ClothMesh();
-  vector<Triangle *> triangles;
-
-  // Create vector of triangles
-  for (int y = 0; y < num_height_points - 1; y++) {
-    for (int x = 0; x < num_width_points - 1; x++) {
-      PointMass *pm = &point_masses[y * num_width_points + x];
-      // Both triangles defined by vertices in counter-clockwise orientation
-      triangles.push_back(new Triangle(pm, pm + num_width_points, pm + 1));
-      triangles.push_back(new Triangle(pm + 1, pm + num_width_points,
-                                       pm + num_width_points + 1));
-    }
-  }
-
-  // For each triangle in row-order, create 3 edges and 3 internal halfedges
-  for (int i = 0; i < triangles.size(); i++) {
-    Triangle *t = triangles[i];
-
-    // Allocate new halfedges on heap
-    Halfedge *h1 = new Halfedge();
-    Halfedge *h2 = new Halfedge();
-    Halfedge *h3 = new Halfedge();
-
-    // Allocate new edges on heap
-    Edge *e1 = new Edge();
-    Edge *e2 = new Edge();
-    Edge *e3 = new Edge();
-
-    // Assign a halfedge pointer to the triangle
-    t->halfedge = h1;
-
-    // Assign halfedge pointers to point masses
-    t->pm1->halfedge = h1;
-    t->pm2->halfedge = h2;
-    t->pm3->halfedge = h3;
-
-    // Update all halfedge pointers
-    h1->edge = e1;
-    h1->next = h2;
-    h1->pm = t->pm1;
-    h1->triangle = t;
-
-    h2->edge = e2;
-    h2->next = h3;
-    h2->pm = t->pm2;
-    h2->triangle = t;
-
-    h3->edge = e3;
-    h3->next = h1;
-    h3->pm = t->pm3;
-    h3->triangle = t;
+  if (clothMesh) {
+    delete clothMesh;
   }
-
-  // Go back through the cloth mesh and link triangles together using halfedge
-  // twin pointers
-
-  // Convenient variables for math
-  int num_height_tris = (num_height_points - 1) * 2;
-  int num_width_tris = (num_width_points - 1) * 2;
-
-  bool topLeft = true;
-  for (int i = 0; i < triangles.size(); i++) {
-    Triangle *t = triangles[i];
-
-    if (topLeft) {
-      // Get left triangle, if it exists
-      if (i % num_width_tris != 0) { // Not a left-most triangle
-        Triangle *temp = triangles[i - 1];
-        t->pm1->halfedge->twin = temp->pm3->halfedge;
-      } else {
-        t->pm1->halfedge->twin = nullptr;
-      }
-
-      // Get triangle above, if it exists
-      if (i >= num_width_tris) { // Not a top-most triangle
-        Triangle *temp = triangles[i - num_width_tris + 1];
-        t->pm3->halfedge->twin = temp->pm2->halfedge;
-      } else {
-        t->pm3->halfedge->twin = nullptr;
-      }
-
-      // Get triangle to bottom right; guaranteed to exist
-      Triangle *temp = triangles[i + 1];
-      t->pm2->halfedge->twin = temp->pm1->halfedge;
-    } else {
-      // Get right triangle, if it exists
-      if (i % num_width_tris != num_width_tris - 1) { // Not a right-most triangle
-        Triangle *temp = triangles[i + 1];
-        t->pm3->halfedge->twin = temp->pm1->halfedge;
-      } else {
-        t->pm3->halfedge->twin = nullptr;
-      }
-
-      // Get triangle below, if it exists
-      if (i + num_width_tris - 1 < 1.0f * num_width_tris * num_height_tris / 2.0f) { // Not a bottom-most triangle
-        Triangle *temp = triangles[i + num_width_tris - 1];
-        t->pm2->halfedge->twin = temp->pm3->halfedge;
-      } else {
-        t->pm2->halfedge->twin = nullptr;
-      }
-
-      // Get triangle to top left; guaranteed to exist
-      Triangle *temp = triangles[i - 1];
-      t->pm1->halfedge->twin = temp->pm2->halfedge;
+  clothMesh = new ClothMesh();
+
+  int cells_x = num_width_points - 1, cells_y = num_height_points - 1;
+  clothMesh->pm.resize(cells_x * cells_y * 6);
+  int32_t *pm = clothMesh->pm.data();
+
+  // Each grid cell is split into triangle A (p, p + w, p + 1) and triangle
+  // B (p + 1, p + w, p + w + 1), both counter-clockwise
+  int w = num_width_points;
+  for (int y = 0; y < cells_y; y++) {
+    for (int x = 0; x < cells_x; x++) {
+      int p = y * w + x;
+      int a = 6 * (y * cells_x + x), b = a + 3;
+
+      pm[a] = p;
+      pm[a + 1] = p + w;
+      pm[a + 2] = p + 1;
+      pm[b] = p + 1;
+      pm[b + 1] = p + w;
+      pm[b + 2] = p + w + 1;
     }
-
-    topLeft = !topLeft;
   }
-
-  clothMesh->triangles = triangles;
-  this->clothMesh = clothMesh;
 }
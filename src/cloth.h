@@ -8,6 +8,7 @@
 #include "CGL/CGL.h"
 #include "CGL/misc.h"
 #include "clothMesh.h"
+#include "collision/collisionBVH.h"
 #include "collision/collisionObject.h"
 #include "spring.h"
 
@@ -41,6 +42,25 @@ struct ClothParameters {
   double ks;
 };
 
+// Springs of one type as indices into the point masses, sorted by
+// pm_b - pm_a and then by pm_a. On a grid this cuts them into long runs of
+// consecutive pm_a at a fixed offset, which the kernels stream through.
+struct ClothSprings {
+  e_spring_type type;
+  vector<int> pm_a;
+  vector<int> pm_b;
+  vector<double> rest_length;
+
+  // first spring of each run, and one past the last spring
+  vector<int> runs;
+
+  // Spring indices grouped by color, no two springs of a color share a
+  // particle, and where each color starts in color_order plus one past the
+  // end
+  vector<int> color_order;
+  vector<int> colors;
+};
+
 struct Cloth {
   Cloth() {}
   Cloth(double width, double height, int num_width_points,
@@ -55,6 +75,12 @@ struct Cloth {
 
   void reset();
   void buildClothMesh();
+  void springForces(ClothSprings &set, double ks);
+  void colorSprings(ClothSprings &set);
+  void limitStrain(ClothSprings &set);
+
+  void collide(vector<CollisionObject *> *collision_objects, double simulation_steps);
+  void sortByMortonCode();
 
   void build_spatial_map();
   void self_collide(PointMass &pm, double simulation_steps);
@@ -66,13 +92,25 @@ struct Cloth {
   int num_width_points;
   int num_height_points;
   double thickness;
-  e_orientation orientation;
+  e_orientation orientation = HORIZONTAL;
 
   // Cloth components
   vector<PointMass> point_masses;
   vector<vector<int>> pinned;
-  vector<Spring> springs;
-  ClothMesh *clothMesh;
+  vector<ClothSprings> springs; // one per spring type
+  ClothMesh *clothMesh = nullptr;
+
+  // Flat copies of the positions and forces the spring kernels run on, and
+  // the force of each spring before it is accumulated
+  vector<double> pos_x, pos_y, pos_z;
+  vector<double> force_x, force_y, force_z;
+  vector<double> spring_x, spring_y, spring_z;
+
+  // Colliders, and the particles in Morton order so the batches queried
+  // against them are compact
+  CollisionBVH collision_bvh;
+  vector<int> collision_order;
+  int steps_since_sort = 0;
 
   // Spatial hashing
   unordered_map<float, vector<PointMass *> *> map;
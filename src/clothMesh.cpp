@@ -1,40 +1,36 @@
 #include "clothMesh.h"
 #include <iostream>
+#include <math.h>
 
 using namespace CGL;
 using namespace std;
 
-Vector3D PointMass::normal() {
-  Vector3D n(0, 0, 0);
+void ClothMesh::computeNormals(const vector<PointMass> &point_masses) {
+  int n = point_masses.size();
+  normal_x.assign(n, 0.0);
+  normal_y.assign(n, 0.0);
+  normal_z.assign(n, 0.0);
 
-  Halfedge *start = halfedge;
-  Halfedge *iter = start;
-
-  // Loop CCW
-  do {
-    n = n + cross(iter->next->pm->position - position, iter->next->next->pm->position - position);
-    if (iter->next->next->twin) {
-      iter = iter->next->next->twin;
-    } else {
-      break;
-    }
-  } while (iter != start);
-
-  if (iter != start ) {
-    // Terminated early from last loop; loop CW now
-    start = halfedge;
-    iter = start;
-    if (iter->twin) {
-      do {
-        n = n + cross(iter->twin->next->next->pm->position - position, iter->twin->pm->position - position);
-        if (iter->twin->next->twin) {
-          iter = iter->twin->next;
-        } else {
-          break;
-        }
-      } while (iter != start);
+  // Every face once: the cross product of two of its edges is the same at
+  // all three corners and weighs the face by its area
+  for (int t = 0; t < numTriangles(); t++) {
+    int a = pm[3 * t], b = pm[3 * t + 1], c = pm[3 * t + 2];
+    Vector3D face = cross(point_masses[b].position - point_masses[a].position,
+                          point_masses[c].position - point_masses[a].position);
+    for (int v : {a, b, c}) {
+      normal_x[v] += face.x;
+      normal_y[v] += face.y;
+      normal_z[v] += face.z;
     }
   }
 
-  return n.unit();
+  double *nx = normal_x.data(), *ny = normal_y.data(), *nz = normal_z.data();
+#pragma omp simd
+  for (int v = 0; v < n; v++) {
+    double length = sqrt(nx[v] * nx[v] + ny[v] * ny[v] + nz[v] * nz[v]);
+    double inv = length > 0.0 ? 1.0 / length : 0.0;
+    nx[v] *= inv;
+    ny[v] *= inv;
+    nz[v] *= inv;
+  }
 }
@@ -1,6 +1,7 @@
 #ifndef CLOTH_MESH_H
 #define CLOTH_MESH_H
 
+#include <stdint.h>
 #include <vector>
 
 #include "CGL/CGL.h"
@@ -9,38 +10,21 @@
 using namespace CGL;
 using namespace std;
 
-class Triangle {
+// Triangle mesh over the point masses of a cloth, as a flat index array.
+// Triangle t has corners 3t, 3t + 1 and 3t + 2, counter-clockwise.
+class ClothMesh {
 public:
-  Triangle(PointMass *pm1, PointMass *pm2, PointMass *pm3)
-      : pm1(pm1), pm2(pm2), pm3(pm3) {}
+  ~ClothMesh() {}
 
-  // Static references to constituent mesh objects
-  PointMass *pm1;
-  PointMass *pm2;
-  PointMass *pm3;
+  int numTriangles() const { return pm.size() / 3; }
 
-  Halfedge *halfedge;
-}; // struct Triangle
+  // Unit vertex normals of all point masses into normal_x/y/z
+  void computeNormals(const vector<PointMass> &point_masses);
 
-class Edge {
-public:
-  Halfedge *halfedge;
-}; // struct Edge
-
-class Halfedge {
-public:
-  Edge *edge;
-  Halfedge *next;
-  Halfedge *twin;
-  Triangle *triangle;
-  PointMass *pm;
-}; // struct Halfedge
-
-class ClothMesh {
-public:
-  ~ClothMesh() {}
+  vector<int32_t> pm; // point mass at each triangle corner
 
-  vector<Triangle *> triangles;
-}; // struct ClothMesh
+  // Vertex normals, one entry per point mass
+  vector<double> normal_x, normal_y, normal_z;
+}; // class ClothMesh
 
 #endif // CLOTH_MESH_H
@@ -7,11 +7,15 @@
 #include "clothSimulator.h"
 
 #include "camera.h"
+#include "checkpoint.h"
+#include "hairGrid.h"
 #include "misc/camera_info.h"
 
 using namespace nanogui;
 using namespace std;
 
+const CGL::Vector3D ClothSimulator::DEFAULT_GRAVITY = CGL::Vector3D(0, -9.8, 0);
+
 ClothSimulator::ClothSimulator(Screen *screen) {
   this->screen = screen;
 
@@ -37,12 +41,38 @@ ClothSimulator::~ClothSimulator() {
     shader.free();
   }
 
-  if (hairs) delete hairs;
+  // The hairs belong to main and own their solvers
+  if (hairs) {
+    for (StrandSolver *solver : hairs->solvers) {
+      if (solver->stats.strand_steps > 0) {
+        cout << solver->name() << ": " << solver->stats.strand_steps << " strand steps, "
+             << 1e6 * solver->stats.seconds / solver->stats.particle_steps
+             << " us per particle step" << endl;
+      }
+    }
+  }
+
+  if (cloth) delete cloth;
+  if (cp) delete cp;
+  if (collision_objects) {
+    for (CollisionObject *co : *collision_objects) {
+      delete co;
+    }
+    delete collision_objects;
+  }
 }
 
 
 void ClothSimulator::loadHair(HairVector *hairs) { this->hairs = hairs; }
 
+void ClothSimulator::loadCloth(Cloth *cloth) { this->cloth = cloth; }
+
+void ClothSimulator::loadClothParameters(ClothParameters *cp) { this->cp = cp; }
+
+void ClothSimulator::loadCollisionObjects(vector<CollisionObject *> *objects) {
+  this->collision_objects = objects;
+}
+
 /**
  * Initializes the cloth simulation and spawns a new thread to separate
  * rendering from simulation.
@@ -54,6 +84,23 @@ void ClothSimulator::init() {
 
   // Initialize camera
 
+  screen_w = default_window_size(0);
+  screen_h = default_window_size(1);
+
+  // canonicalCamera is a copy used for view resets
+
+  canonical_view_distance = placeCamera(hairs, cloth, camera, screen_w, screen_h);
+  canonicalCamera = camera;
+
+  scroll_rate = canonical_view_distance / 10;
+
+  view_distance = canonical_view_distance * 2;
+  min_view_distance = canonical_view_distance / 10.0;
+  max_view_distance = canonical_view_distance * 20.0;
+}
+
+double ClothSimulator::placeCamera(HairVector *hairs, Cloth *cloth, CGL::Camera &camera,
+                                   int width, int height) {
   CGL::Collada::CameraInfo camera_info;
   camera_info.hFov = 50;
   camera_info.vFov = 35;
@@ -63,37 +110,37 @@ void ClothSimulator::init() {
   // Try to intelligently figure out the camera target
 
   Vector3D avg_pm_position(0, 0, 0);
+  double canonical_view_distance = 1.0;
+
+  if (!hairs->hair_vector->empty()) {
+    for (Hair *hair : *(hairs->hair_vector)) {
+      for (auto &pm : hair->point_masses) {
+        avg_pm_position += pm.position / hair->point_masses.size();
+      }
+    }
 
-  for (Hair *hair : *(hairs->hair_vector)) {
-    for (auto &pm : hair->point_masses) {
-      avg_pm_position += pm.position / hair->point_masses.size();
+    avg_pm_position /= (double) hairs->hair_vector->size();
+    Hair* hair = (*(hairs->hair_vector))[0];
+    canonical_view_distance = hair->length * 0.9;
+  } else if (cloth) {
+    for (auto &pm : cloth->point_masses) {
+      avg_pm_position += pm.position / cloth->point_masses.size();
     }
+    canonical_view_distance = max(cloth->width, cloth->height) * 0.9;
   }
 
-  avg_pm_position /= (double) hairs->hair_vector->size();
   CGL::Vector3D target(avg_pm_position.x, avg_pm_position.y / 2, avg_pm_position.z);
   CGL::Vector3D c_dir(0., 0., 0.);
 
-  Hair* hair = (*(hairs->hair_vector))[0];
-  canonical_view_distance = hair->length * 0.9;
-  scroll_rate = canonical_view_distance / 10;
-
-  view_distance = canonical_view_distance * 2;
-  min_view_distance = canonical_view_distance / 10.0;
-  max_view_distance = canonical_view_distance * 20.0;
-
-  // canonicalCamera is a copy used for view resets
+  double view_distance = canonical_view_distance * 2;
+  double min_view_distance = canonical_view_distance / 10.0;
+  double max_view_distance = canonical_view_distance * 20.0;
 
   camera.place(target, acos(c_dir.y), atan2(c_dir.x, c_dir.z), view_distance,
                min_view_distance, max_view_distance);
-  canonicalCamera.place(target, acos(c_dir.y), atan2(c_dir.x, c_dir.z),
-                        view_distance, min_view_distance, max_view_distance);
+  camera.configure(camera_info, width, height);
 
-  screen_w = default_window_size(0);
-  screen_h = default_window_size(1);
-
-  camera.configure(camera_info, screen_w, screen_h);
-  canonicalCamera.configure(camera_info, screen_w, screen_h);
+  return canonical_view_distance;
 }
 
 bool ClothSimulator::isAlive() { return is_alive; }
@@ -117,9 +164,23 @@ void ClothSimulator::drawContents() {
     }
     external_accelerations.push_back(accel);
 
-    for (int i = 0; i < simulation_steps; i++) {
-      hairs->simulate(frames_per_sec, simulation_steps, external_accelerations);
+    hairs->updateLOD(camera.position());
+
+    if (adaptive_steps) {
+      step_controller.advanceFrame(hairs, frames_per_sec, external_accelerations);
+    } else {
+      step_controller.sync(hairs, 1.0 / frames_per_sec / simulation_steps);
+      for (int i = 0; i < simulation_steps; i++) {
+        hairs->simulate(frames_per_sec, simulation_steps, external_accelerations);
+      }
     }
+    if (cloth) {
+      for (int i = 0; i < simulation_steps; i++) {
+        cloth->simulate(frames_per_sec, simulation_steps, cp, external_accelerations,
+                        collision_objects);
+      }
+    }
+    hairs->frame++;
 
     external_accelerations = {gravity};
     left_pressed = false;
@@ -150,6 +211,7 @@ void ClothSimulator::drawContents() {
   case WIREFRAME:
     drawHead(shader);
     drawHair(shader);
+    drawCloth(shader);
 //    drawRestPose(shader);
 //    drawStretchSprings(shader);
 //    drawSupportSprings(shader);
@@ -157,14 +219,55 @@ void ClothSimulator::drawContents() {
 //    drawLocalFrame(shader);
 //    drawTargetVector(shader);
     break;
+  case NORMALS:
+    drawClothShaded(shader);
+    break;
+  case PHONG: {
+    Vector3D cam_pos = camera.position();
+    shader.setUniform("in_color", color);
+    shader.setUniform("eye", Vector3f(cam_pos.x, cam_pos.y, cam_pos.z));
+    shader.setUniform("light", Vector3f(0.5, 2, 2));
+    drawClothShaded(shader);
+    break;
+  }
   }
+
+  // The shaded modes only apply to surfaces, hair stays lines
+  if (activeShader != WIREFRAME) {
+    wireframeShader.bind();
+    wireframeShader.setUniform("model", model);
+    wireframeShader.setUniform("viewProjection", viewProjection);
+    drawHead(wireframeShader);
+    drawHair(wireframeShader);
+  }
+
+  // The viewport alone, before nanogui draws on top of it
+  if (screenshot_requested || recording) {
+    const char *extension = capture_format == FrameCapture::EXR ? "exr" : "png";
+    char filename[1024];
+    if (recording) {
+      snprintf(filename, sizeof(filename), "%s_%05d.%s", capture_prefix.c_str(),
+               recorded_frames++, extension);
+    } else {
+      snprintf(filename, sizeof(filename), "%s_frame%ld.%s", capture_prefix.c_str(),
+               hairs->frame, extension);
+      cout << "Saving " << filename << endl;
+    }
+    frame_capture.capture(filename, capture_format);
+    screenshot_requested = false;
+  }
+  frame_capture.poll();
 }
 
+void ClothSimulator::finishCapture() { frame_capture.finish(); }
+
 void ClothSimulator::drawHead(GLShader &shader) {
+  if (hairs->hair_vector->empty()) return;
+
   Vector3D center = Vector3D();
 
   for (Hair* hair : *(hairs->hair_vector)) {
-    center += hair->point_masses[0].start_position;
+    center += hair->point_masses[0].position;
   }
   center /= hairs->num_hairs;
 
@@ -196,6 +299,60 @@ void ClothSimulator::drawHead(GLShader &shader) {
 
 }
 
+void ClothSimulator::drawCloth(GLShader &shader) {
+  if (!cloth) return;
+
+  // Structural and shearing springs as lines
+  int num_springs = cloth->springs[STRUCTURAL].pm_a.size() + cloth->springs[SHEARING].pm_a.size();
+  MatrixXf positions(3, num_springs * 2);
+
+  int si = 0;
+  for (int type : {STRUCTURAL, SHEARING}) {
+    ClothSprings &set = cloth->springs[type];
+    for (int k = 0; k < set.pm_a.size(); k++) {
+      Vector3D pa = cloth->point_masses[set.pm_a[k]].position;
+      Vector3D pb = cloth->point_masses[set.pm_b[k]].position;
+      positions.col(si) << pa.x, pa.y, pa.z;
+      positions.col(si + 1) << pb.x, pb.y, pb.z;
+      si += 2;
+    }
+  }
+
+  shader.setUniform("in_color", nanogui::Color(1.0f, 1.0f, 1.0f, 1.0f));
+  shader.uploadAttrib("in_position", positions);
+  shader.drawArray(GL_LINES, 0, num_springs * 2);
+
+  for (CollisionObject *co : *collision_objects) {
+    co->render(shader);
+  }
+}
+
+void ClothSimulator::drawClothShaded(GLShader &shader) {
+  if (!cloth || !cloth->clothMesh) return;
+
+  ClothMesh *mesh = cloth->clothMesh;
+  mesh->computeNormals(cloth->point_masses);
+
+  int num_corners = mesh->pm.size();
+  MatrixXf positions(3, num_corners);
+  MatrixXf normals(3, num_corners);
+
+  for (int h = 0; h < num_corners; h++) {
+    int v = mesh->pm[h];
+    Vector3D p = cloth->point_masses[v].position;
+    positions.col(h) << p.x, p.y, p.z;
+    normals.col(h) << mesh->normal_x[v], mesh->normal_y[v], mesh->normal_z[v];
+  }
+
+  shader.uploadAttrib("in_position", positions);
+  shader.uploadAttrib("in_normal", normals);
+  shader.drawArray(GL_TRIANGLES, 0, num_corners);
+
+  for (CollisionObject *co : *collision_objects) {
+    co->render(shader);
+  }
+}
+
 void ClothSimulator::drawHair(GLShader &shader) {
   //bezier curve
   for (Hair* hair : *(hairs->hair_vector)) {
@@ -239,7 +396,17 @@ void ClothSimulator::drawHair(GLShader &shader) {
       si += 2;
     }
 
-    shader.setUniform("in_color", nanogui::Color(0.698f, 0.133f, 0.133f, 1.0f));
+    // Darken strands by their mean deep opacity shadow
+    float shade = 1.0f;
+    if (hairs->volume) {
+      double transmittance = 0;
+      for (PointMass &pm : hair->point_masses) {
+        transmittance += hairs->volume->transmittance(pm.position);
+      }
+      shade = (float) (0.35 + 0.65 * transmittance / hair->point_masses.size());
+    }
+
+    shader.setUniform("in_color", nanogui::Color(0.698f * shade, 0.133f * shade, 0.133f * shade, 1.0f));
     shader.uploadAttrib("in_position", curve);
     shader.drawArray(GL_LINE_STRIP, 0, (curvePoints.size()-1) * 2);
   }
@@ -571,7 +738,11 @@ void ClothSimulator::evaluateStep() {
 
 void ClothSimulator::resetCamera() { camera.copy_placement(canonicalCamera); }
 
-Matrix4f ClothSimulator::getProjectionMatrix() {
+Matrix4f ClothSimulator::getProjectionMatrix() { return projectionMatrix(camera); }
+
+Matrix4f ClothSimulator::getViewMatrix() { return viewMatrix(camera); }
+
+Matrix4f ClothSimulator::projectionMatrix(const CGL::Camera &camera) {
   Matrix4f perspective;
   perspective.setZero();
 
@@ -592,7 +763,7 @@ Matrix4f ClothSimulator::getProjectionMatrix() {
   return perspective;
 }
 
-Matrix4f ClothSimulator::getViewMatrix() {
+Matrix4f ClothSimulator::viewMatrix(const CGL::Camera &camera) {
   Matrix4f lookAt;
   Matrix3f R;
 
@@ -702,10 +873,10 @@ bool ClothSimulator::keyCallbackEvent(int key, int scancode, int action,
     case GLFW_KEY_ESCAPE:
       is_alive = false;
       break;
-//    case 'r':
-//    case 'R':
-//      cloth->reset();
-//      break;
+    case 'r':
+    case 'R':
+      if (cloth) cloth->reset();
+      break;
     case ' ':
       resetCamera();
       break;
@@ -721,6 +892,32 @@ bool ClothSimulator::keyCallbackEvent(int key, int scancode, int action,
         is_paused = true;
       }
       break;
+    case 'c':
+    case 'C':
+      if (saveCheckpoint(checkpoint_file, hairs)) {
+        cout << "Saved frame " << hairs->frame << " to " << checkpoint_file << endl;
+      }
+      break;
+    case 's':
+    case 'S':
+      screenshot_requested = true;
+      break;
+    case 'v':
+    case 'V':
+      recording = !recording;
+      if (recording) {
+        recorded_frames = 0;
+        cout << "Recording to " << capture_prefix << "_*" << endl;
+      } else {
+        cout << "Recorded " << recorded_frames << " frames" << endl;
+      }
+      break;
+    case 'l':
+    case 'L':
+      if (loadCheckpoint(checkpoint_file, hairs)) {
+        cout << "Loaded frame " << hairs->frame << " from " << checkpoint_file << endl;
+      }
+      break;
       case GLFW_KEY_LEFT:
         left_pressed = true;
         break;
@@ -779,12 +976,12 @@ void ClothSimulator::initGUI(Screen *screen) {
     b->setChangeCallback(
             [this](bool state) { hairs->enable_support_constraints = state; });
 
-//    b = new Button(window, "bending");
-//    b->setFlags(Button::ToggleButton);
-//    b->setPushed(hairs->enable_bending_constraints);
-//    b->setFontSize(14);
-//    b->setChangeCallback(
-//        [this](bool state) { hairs->enable_bending_constraints = state; });
+    b = new Button(window, "bending");
+    b->setFlags(Button::ToggleButton);
+    b->setPushed(hairs->enable_bending_constraints);
+    b->setFontSize(14);
+    b->setChangeCallback(
+        [this](bool state) { hairs->enable_bending_constraints = state; });
 
     b = new Button(window, "core");
     b->setFlags(Button::ToggleButton);
@@ -871,6 +1068,54 @@ void ClothSimulator::initGUI(Screen *screen) {
     num_steps->setSpinnable(true);
     num_steps->setMinValue(0);
     num_steps->setCallback([this](int value) { simulation_steps = value; });
+
+    new Label(panel, "adaptive :", "sans-bold");
+
+    CheckBox *adaptive = new CheckBox(panel, "");
+    adaptive->setChecked(adaptive_steps);
+    adaptive->setFontSize(14);
+    adaptive->setCallback([this](bool state) { adaptive_steps = state; });
+
+    new Label(panel, "LOD :", "sans-bold");
+
+    CheckBox *lod = new CheckBox(panel, "");
+    lod->setChecked(hairs->enable_lod);
+    lod->setFontSize(14);
+    lod->setCallback([this](bool state) { hairs->enable_lod = state; });
+
+    new Label(panel, "sleep :", "sans-bold");
+
+    CheckBox *sleep = new CheckBox(panel, "");
+    sleep->setChecked(hairs->enable_sleep);
+    sleep->setFontSize(14);
+    sleep->setCallback([this](bool state) {
+      hairs->enable_sleep = state;
+      hairs->wake();
+    });
+
+    new Label(panel, "tethers :", "sans-bold");
+
+    CheckBox *tethers = new CheckBox(panel, "");
+    tethers->setChecked(hairs->enable_tethers);
+    tethers->setFontSize(14);
+    tethers->setCallback([this](bool state) { hairs->enable_tethers = state; });
+
+    new Label(panel, "solver :", "sans-bold");
+
+    if (!hairs->solver) {
+      hairs->setSolver(hairs->solverNamed("mass spring"));
+    }
+    vector<string> names = strandSolverNames();
+    int current = 0;
+    for (int i = 0; i < names.size(); i++) {
+      if (names[i] == hairs->solver->name()) current = i;
+    }
+
+    ComboBox *solver = new ComboBox(panel, names);
+    solver->setFontSize(14);
+    solver->setSelectedIndex(current);
+    solver->setCallback(
+        [this, names](int idx) { hairs->setSolver(hairs->solverNamed(names[idx])); });
   }
 
   // Damping & spring constants slider and textbox
@@ -966,6 +1211,15 @@ void ClothSimulator::initGUI(Screen *screen) {
     });
   }
 
+  new Label(window, "Appearance", "sans-bold");
+
+  {
+    ComboBox *cb = new ComboBox(window, {"Wireframe", "Normals", "Shaded"});
+    cb->setFontSize(14);
+    cb->setCallback(
+        [this, screen](int idx) { activeShader = static_cast<e_shader>(idx); });
+  }
+
 
   }
 
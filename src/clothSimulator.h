@@ -4,8 +4,13 @@
 #include <nanogui/nanogui.h>
 
 #include "camera.h"
+#include "cloth.h"
+#include "collision/collisionObject.h"
+#include "frameCapture.h"
 #include "hair.h"
 #include "HairVector.h"
+#include "stepController.h"
+#include "strandSolver.h"
 
 using namespace nanogui;
 
@@ -17,6 +22,9 @@ public:
   void init();
 
   void loadHair(HairVector *hair);
+  void loadCloth(Cloth *cloth);
+  void loadClothParameters(ClothParameters *cp);
+  void loadCollisionObjects(vector<CollisionObject *> *objects);
   virtual bool isAlive();
   virtual void drawContents();
 
@@ -29,9 +37,37 @@ public:
   virtual bool scrollCallbackEvent(double x, double y);
   virtual bool resizeCallbackEvent(int width, int height);
 
+  // Written with 'c' and read back with 'l'
+  string checkpoint_file = "hair.ckpt";
+
+  // 's' saves the next frame as <prefix>_frame<n>, 'v' starts and stops
+  // recording every frame as <prefix>_<00000>
+  string capture_prefix = "capture";
+  FrameCapture::e_format capture_format = FrameCapture::PNG;
+
+  // Writes out the frames still being read back or encoded
+  void finishCapture();
+
+  // Frames the groom (or the cloth without one) the way the viewer starts
+  // out and returns the distance the view is scaled by
+  static double placeCamera(HairVector *hairs, Cloth *cloth, CGL::Camera &camera, int width,
+                            int height);
+
+  // The matrices the viewport is drawn with
+  static Matrix4f projectionMatrix(const CGL::Camera &camera);
+  static Matrix4f viewMatrix(const CGL::Camera &camera);
+
+  // The simulation settings the viewer starts with, also those of the
+  // preroll and playblasts
+  static const int DEFAULT_FRAMES_PER_SEC = 24;
+  static const int DEFAULT_SIMULATION_STEPS = 15;
+  static const CGL::Vector3D DEFAULT_GRAVITY;
+
 private:
   virtual void initGUI(Screen *screen);
   void drawHead(GLShader &shader);
+  void drawCloth(GLShader &shader);
+  void drawClothShaded(GLShader &shader);
   void drawHair(GLShader &shader);
   void drawRestPose(GLShader &shader);
   void drawStretchSprings(GLShader &shader);
@@ -52,19 +88,26 @@ private:
 
   // Default simulation values
 
-  int frames_per_sec = 24;    // 24 - 15
-  int simulation_steps = 15;
+  int frames_per_sec = DEFAULT_FRAMES_PER_SEC;    // 24 - 15
+  int simulation_steps = DEFAULT_SIMULATION_STEPS;
+  bool adaptive_steps = false;
+  StepController step_controller;
 
-  CGL::Vector3D gravity = CGL::Vector3D(0, -9.8, 0);
+  CGL::Vector3D gravity = DEFAULT_GRAVITY;
   nanogui::Color color = nanogui::Color(1.0f, 0.0f, 0.0f, 1.0f);
 
   HairVector *hairs;
 
 //  Hair *hair;
 
+  // Optional cloth, simulated alongside the hair
+  Cloth *cloth = nullptr;
+  ClothParameters *cp = nullptr;
+  vector<CollisionObject *> *collision_objects = nullptr;
+
   // OpenGL attributes
 
-  enum e_shader { WIREFRAME = 0};
+  enum e_shader { WIREFRAME = 0, NORMALS = 1, PHONG = 2 };
   e_shader activeShader = WIREFRAME;
 
   vector<GLShader> shaders;
@@ -110,6 +153,13 @@ private:
 
   bool is_paused = false;
 
+  // Capture state
+
+  FrameCapture frame_capture;
+  bool screenshot_requested = false;
+  bool recording = false;
+  int recorded_frames = 0;
+
   // Screen attributes
 
   int mouse_x;
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <math.h>
+#include <nanogui/nanogui.h>
+
+#include "../clothMesh.h"
+#include "../misc/sphere_drawing.h"
+#include "capsule.h"
+
+using namespace nanogui;
+using namespace CGL;
+
+#define CAPSULE_SEGMENTS 24
+
+Vector3D Capsule::closestOnAxis(const Vector3D &p) {
+  double t = axis2 > 0 ? dot(p - start, axis) / axis2 : 0;
+  return start + std::min(1.0, std::max(0.0, t)) * axis;
+}
+
+void Capsule::collide(PointMass &pm) {
+  Vector3D c = closestOnAxis(pm.position);
+  Vector3D d = pm.position - c;
+  double d2 = d.norm2();
+
+  Vector3D surface_point;
+  if (d2 < radius * radius) {
+    // Out along the radius through the particle; one on the axis (up to
+    // rounding) goes back the way it came, or off the axis any way if it
+    // came along it
+    Vector3D dir = d;
+    if (d2 < 1e-12 * radius * radius) {
+      dir = pm.last_position - pm.position;
+      if (axis2 > 0) dir -= dot(dir, axis) / axis2 * axis;
+      if (dir.norm2() == 0) dir = perpendicular();
+    }
+    surface_point = c + dir.unit() * radius;
+  } else if (!sweep(pm.last_position, pm.position, surface_point)) {
+    return;
+  }
+
+  pm.position = pm.last_position + (1.0 - friction) * (surface_point - pm.last_position);
+}
+
+void Capsule::collideEdge(PointMass &a, PointMass &b) {
+  // Closest points of the edge and the axis, a + t * edge and
+  // start + s * axis (Ericson, Real-Time Collision Detection 5.1.9)
+  Vector3D edge = b.position - a.position;
+  double length2 = edge.norm2();
+  if (length2 == 0) return;
+  Vector3D r = a.position - start;
+  double c = dot(edge, r);
+
+  double t, s = 0;
+  if (axis2 == 0) {
+    t = std::min(1.0, std::max(0.0, -c / length2));
+  } else {
+    double e = dot(edge, axis), f = dot(axis, r);
+    double denom = length2 * axis2 - e * e;
+    // Parallel: the point of the edge nearest the middle of the axis
+    t = denom > 1e-12 * length2 * axis2 ? (e * f - c * axis2) / denom
+                                        : (e * 0.5 - c) / length2;
+    t = std::min(1.0, std::max(0.0, t));
+    s = (e * t + f) / axis2;
+    if (s < 0) {
+      s = 0;
+      t = std::min(1.0, std::max(0.0, -c / length2));
+    } else if (s > 1) {
+      s = 1;
+      t = std::min(1.0, std::max(0.0, (e - c) / length2));
+    }
+  }
+  if (t <= 0 || t >= 1) return;
+
+  Vector3D closest = a.position + t * edge;
+  Vector3D d = closest - (start + s * axis);
+  double d2 = d.norm2();
+  if (d2 >= radius * radius || d2 == 0) return;
+
+  // Push the edge out at that point like Sphere::collideEdge
+  Vector3D push = d * (radius / sqrt(d2) - 1.0);
+  double wa = a.pinned ? 0.0 : 1.0 - t, wb = b.pinned ? 0.0 : t;
+  double w2 = wa * wa + wb * wb;
+  if (w2 == 0) return;
+  a.position += push * (wa / w2);
+  b.position += push * (wb / w2);
+}
+
+Vector3D Capsule::perpendicular() {
+  if (axis2 == 0) return Vector3D(1, 0, 0);
+  Vector3D w = axis / sqrt(axis2);
+  return cross(w, fabs(w.x) < 0.9 ? Vector3D(1, 0, 0) : Vector3D(0, 1, 0)).unit();
+}
+
+double Capsule::distance(const Vector3D &p) {
+  return (p - closestOnAxis(p)).norm() - radius;
+}
+
+void Capsule::distances(const double *x, const double *y, const double *z, int n,
+                        double *out) {
+  double sx = start.x, sy = start.y, sz = start.z;
+  double ax = axis.x, ay = axis.y, az = axis.z;
+  double inv_axis2 = axis2 > 0 ? 1.0 / axis2 : 0.0;
+#pragma omp simd
+  for (int i = 0; i < n; i++) {
+    double px = x[i] - sx, py = y[i] - sy, pz = z[i] - sz;
+    double t = std::min(1.0, std::max(0.0, (px * ax + py * ay + pz * az) * inv_axis2));
+    double dx = px - t * ax, dy = py - t * ay, dz = pz - t * az;
+    out[i] = sqrt(dx * dx + dy * dy + dz * dz) - radius;
+  }
+}
+
+bool Capsule::bounds(Vector3D &min, Vector3D &max) {
+  for (int k = 0; k < 3; k++) {
+    min[k] = std::min(start[k], end[k]) - radius;
+    max[k] = std::max(start[k], end[k]) + radius;
+  }
+  return true;
+}
+
+void Capsule::render(GLShader &shader) {
+  // Shrunk like the sphere, so flat triangles do not poke through
+  double r = radius * 0.92;
+  Misc::draw_sphere(shader, start, r);
+  Misc::draw_sphere(shader, end, r);
+
+  Matrix4f model;
+  model.setIdentity();
+  shader.setUniform("model", model);
+
+  // Side of the cylinder between the caps
+  Vector3D w = axis.unit();
+  Vector3D u = perpendicular();
+  Vector3D v = cross(w, u);
+
+  MatrixXf positions(3, CAPSULE_SEGMENTS * 6);
+  MatrixXf normals(3, CAPSULE_SEGMENTS * 6);
+  int col = 0;
+  for (int j = 0; j < CAPSULE_SEGMENTS; j++) {
+    double a0 = 2.0 * PI * j / CAPSULE_SEGMENTS, a1 = 2.0 * PI * (j + 1) / CAPSULE_SEGMENTS;
+    Vector3D n0 = cos(a0) * u + sin(a0) * v, n1 = cos(a1) * u + sin(a1) * v;
+    Vector3D corners[6] = {start + r * n0, start + r * n1, end + r * n1,
+                           end + r * n1, end + r * n0, start + r * n0};
+    Vector3D corner_normals[6] = {n0, n1, n1, n1, n0, n0};
+    for (int k = 0; k < 6; k++) {
+      positions.col(col) << corners[k].x, corners[k].y, corners[k].z;
+      normals.col(col) << corner_normals[k].x, corner_normals[k].y, corner_normals[k].z;
+      col++;
+    }
+  }
+
+  shader.uploadAttrib("in_position", positions);
+  shader.uploadAttrib("in_normal", normals);
+  shader.drawArray(GL_TRIANGLES, 0, CAPSULE_SEGMENTS * 6);
+}
@@ -0,0 +1,39 @@
+#ifndef COLLISIONOBJECT_CAPSULE_H
+#define COLLISIONOBJECT_CAPSULE_H
+
+#include "../clothMesh.h"
+#include "collisionObject.h"
+
+using namespace CGL;
+using namespace std;
+
+// All points within radius of the segment from start to end, the usual
+// stand-in for limbs and necks
+struct Capsule : public CollisionObject {
+public:
+  Capsule(const Vector3D &start, const Vector3D &end, double radius, double friction)
+      : start(start), end(end), axis(end - start), axis2((end - start).norm2()),
+        radius(radius), friction(friction) {}
+
+  void render(GLShader &shader);
+  void collide(PointMass &pm);
+  void collideEdge(PointMass &a, PointMass &b);
+  double distance(const Vector3D &p);
+  void distances(const double *x, const double *y, const double *z, int n, double *out);
+  bool bounds(Vector3D &min, Vector3D &max);
+
+private:
+  Vector3D closestOnAxis(const Vector3D &p);
+  // Unit vector at right angles to the axis
+  Vector3D perpendicular();
+
+  Vector3D start;
+  Vector3D end;
+  Vector3D axis;
+  double axis2;
+  double radius;
+
+  double friction;
+};
+
+#endif /* COLLISIONOBJECT_CAPSULE_H */
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <float.h>
+
+#include "collisionBVH.h"
+
+using namespace std;
+using namespace CGL;
+
+// Objects per leaf before splitting is considered, and centroid bins per
+// split
+static const int LEAF_SIZE = 2;
+static const int SAH_BINS = 12;
+
+// Deeper nodes stay leaves, which bounds the traversal stack
+static const int MAX_DEPTH = 48;
+
+static double halfArea(const Vector3D &min, const Vector3D &max) {
+  Vector3D d = max - min;
+  return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static void grow(Vector3D &min, Vector3D &max, const Vector3D &lo, const Vector3D &hi) {
+  for (int k = 0; k < 3; k++) {
+    min[k] = std::min(min[k], lo[k]);
+    max[k] = std::max(max[k], hi[k]);
+  }
+}
+
+void CollisionBVH::update(const vector<CollisionObject *> &objects, bool refit) {
+  if (objects == source) {
+    if (refit) this->refit();
+  } else {
+    source = objects;
+    build();
+  }
+}
+
+void CollisionBVH::build() {
+  objects.clear();
+  unbounded.clear();
+  object_min.clear();
+  object_max.clear();
+  nodes.clear();
+  moved_min.clear();
+  moved_max.clear();
+
+  for (CollisionObject *co : source) {
+    Vector3D min, max;
+    if (co->bounds(min, max)) {
+      objects.push_back(co);
+      object_min.push_back(min);
+      object_max.push_back(max);
+    } else {
+      unbounded.push_back(co);
+    }
+  }
+  if (objects.empty()) return;
+
+  // Everything is new to whatever rests near it
+  moved_min = object_min;
+  moved_max = object_max;
+
+  nodes.reserve(2 * objects.size());
+  nodes.push_back(Node());
+  split(0, 0, objects.size(), 0);
+}
+
+void CollisionBVH::split(int node, int start, int end, int depth) {
+  Vector3D min(DBL_MAX, DBL_MAX, DBL_MAX), max(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+  Vector3D c_min = min, c_max = max;
+  for (int i = start; i < end; i++) {
+    grow(min, max, object_min[i], object_max[i]);
+    Vector3D c = (object_min[i] + object_max[i]) / 2;
+    grow(c_min, c_max, c, c);
+  }
+  nodes[node].min = min;
+  nodes[node].max = max;
+  nodes[node].start = start;
+  nodes[node].count = end - start;
+
+  int count = end - start;
+  if (count <= LEAF_SIZE || depth == MAX_DEPTH) return;
+
+  // Bin the centroids along the longest axis of their bounds
+  Vector3D extent = c_max - c_min;
+  int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+  if (extent[axis] <= 0) return;
+
+  double scale = SAH_BINS / extent[axis];
+  auto binOf = [&](int i) {
+    double c = (object_min[i][axis] + object_max[i][axis]) / 2;
+    return std::min(SAH_BINS - 1, (int) ((c - c_min[axis]) * scale));
+  };
+
+  int bin_count[SAH_BINS] = {0};
+  Vector3D bin_min[SAH_BINS], bin_max[SAH_BINS];
+  for (int b = 0; b < SAH_BINS; b++) {
+    bin_min[b] = Vector3D(DBL_MAX, DBL_MAX, DBL_MAX);
+    bin_max[b] = Vector3D(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+  }
+  for (int i = start; i < end; i++) {
+    int b = binOf(i);
+    bin_count[b]++;
+    grow(bin_min[b], bin_max[b], object_min[i], object_max[i]);
+  }
+
+  // Cost of splitting after each bin, sweeping from the right and then
+  // from the left
+  double right_cost[SAH_BINS];
+  Vector3D r_min(DBL_MAX, DBL_MAX, DBL_MAX), r_max(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+  int r_count = 0;
+  for (int b = SAH_BINS - 1; b > 0; b--) {
+    r_count += bin_count[b];
+    grow(r_min, r_max, bin_min[b], bin_max[b]);
+    right_cost[b - 1] = r_count ? r_count * halfArea(r_min, r_max) : 0;
+  }
+
+  int best = -1;
+  double best_cost = count * halfArea(min, max); // cost of keeping a leaf
+  Vector3D l_min(DBL_MAX, DBL_MAX, DBL_MAX), l_max(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+  int l_count = 0;
+  for (int b = 0; b + 1 < SAH_BINS; b++) {
+    l_count += bin_count[b];
+    grow(l_min, l_max, bin_min[b], bin_max[b]);
+    if (l_count == 0 || l_count == count) continue;
+    double cost = l_count * halfArea(l_min, l_max) + right_cost[b];
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = b;
+    }
+  }
+  if (best < 0) return;
+
+  int mid = start;
+  for (int i = start; i < end; i++) {
+    if (binOf(i) <= best) {
+      swap(objects[i], objects[mid]);
+      swap(object_min[i], object_min[mid]);
+      swap(object_max[i], object_max[mid]);
+      mid++;
+    }
+  }
+
+  int left = nodes.size();
+  nodes[node].start = left;
+  nodes[node].count = 0;
+  nodes.push_back(Node());
+  nodes.push_back(Node());
+  split(left, start, mid, depth + 1);
+  split(left + 1, mid, end, depth + 1);
+}
+
+void CollisionBVH::refit() {
+  moved_min.clear();
+  moved_max.clear();
+  for (int i = 0; i < objects.size(); i++) {
+    Vector3D min, max;
+    objects[i]->bounds(min, max);
+    if (min == object_min[i] && max == object_max[i]) continue;
+
+    Vector3D swept_min = object_min[i], swept_max = object_max[i];
+    grow(swept_min, swept_max, min, max);
+    moved_min.push_back(swept_min);
+    moved_max.push_back(swept_max);
+    object_min[i] = min;
+    object_max[i] = max;
+  }
+
+  // Children always come after their parent
+  for (int n = nodes.size() - 1; n >= 0; n--) {
+    Node &node = nodes[n];
+    if (node.count > 0) {
+      node.min = object_min[node.start];
+      node.max = object_max[node.start];
+      for (int i = node.start + 1; i < node.start + node.count; i++) {
+        grow(node.min, node.max, object_min[i], object_max[i]);
+      }
+    } else {
+      node.min = nodes[node.start].min;
+      node.max = nodes[node.start].max;
+      grow(node.min, node.max, nodes[node.start + 1].min, nodes[node.start + 1].max);
+    }
+  }
+}
+
+bool CollisionBVH::moved(const Vector3D &min, const Vector3D &max) const {
+  for (int i = 0; i < moved_min.size(); i++) {
+    if (moved_max[i].x < min.x || moved_min[i].x > max.x ||
+        moved_max[i].y < min.y || moved_min[i].y > max.y ||
+        moved_max[i].z < min.z || moved_min[i].z > max.z) {
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+void CollisionBVH::query(const Vector3D &min, const Vector3D &max,
+                         vector<CollisionObject *> &hits) const {
+  hits.insert(hits.end(), unbounded.begin(), unbounded.end());
+  if (nodes.empty()) return;
+
+  int stack[MAX_DEPTH + 2];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node &node = nodes[stack[--top]];
+    if (node.max.x < min.x || node.min.x > max.x ||
+        node.max.y < min.y || node.min.y > max.y ||
+        node.max.z < min.z || node.min.z > max.z) {
+      continue;
+    }
+    if (node.count > 0) {
+      for (int i = node.start; i < node.start + node.count; i++) {
+        if (object_max[i].x < min.x || object_min[i].x > max.x ||
+            object_max[i].y < min.y || object_min[i].y > max.y ||
+            object_max[i].z < min.z || object_min[i].z > max.z) {
+          continue;
+        }
+        hits.push_back(objects[i]);
+      }
+    } else {
+      stack[top++] = node.start;
+      stack[top++] = node.start + 1;
+    }
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef COLLISIONOBJECT_BVH_H
+#define COLLISIONOBJECT_BVH_H
+
+#include <vector>
+
+#include "collisionObject.h"
+
+using namespace CGL;
+using namespace std;
+
+/**
+ * Bounding volume hierarchy over the bounded collision objects of a scene,
+ * so a batch of particles only visits the colliders near it.
+ *
+ * The tree is built with the surface area heuristic over binned centroids,
+ * and refit bottom up while the set of objects stays the same, so moving
+ * colliders only cost a pass over the nodes. Callers refit once a frame.
+ * Objects without bounds (planes) are returned by every query.
+ */
+class CollisionBVH {
+public:
+  // Rebuild if the list of objects changed since the last call, otherwise
+  // refit to where the objects are now if asked to
+  void update(const vector<CollisionObject *> &objects, bool refit);
+
+  // Appends every object whose bounds overlap the box [min, max]
+  void query(const Vector3D &min, const Vector3D &max,
+             vector<CollisionObject *> &hits) const;
+
+  // Whether an object that moved or appeared in the last update, where it
+  // was or is now, overlaps the box [min, max]
+  bool moved(const Vector3D &min, const Vector3D &max) const;
+  bool anyMoved() const { return !moved_min.empty(); }
+
+  int size() const { return source.size(); }
+
+private:
+  // Inner nodes have count == 0 and their children at start and start + 1,
+  // leaves hold objects[start, start + count)
+  struct Node {
+    Vector3D min, max;
+    int start;
+    int count;
+  };
+
+  void build();
+  void split(int node, int start, int end, int depth);
+  void refit();
+
+  vector<CollisionObject *> source;    // the list the tree was built from
+  vector<CollisionObject *> objects;   // bounded objects in leaf order
+  vector<CollisionObject *> unbounded;
+  vector<Vector3D> object_min, object_max;
+  vector<Node> nodes;
+
+  // Boxes around the old and new bounds of the objects that moved
+  vector<Vector3D> moved_min, moved_max;
+};
+
+#endif /* COLLISIONOBJECT_BVH_H */
@@ -0,0 +1,35 @@
+#include "collisionObject.h"
+
+using namespace CGL;
+
+// Distance below which a sweep counts as touching, and its step limit
+#define SWEEP_TOLERANCE 1e-6
+#define SWEEP_ITERATIONS 32
+
+void CollisionObject::distances(const double *x, const double *y, const double *z, int n,
+                                double *out) {
+  for (int i = 0; i < n; i++) {
+    out[i] = distance(Vector3D(x[i], y[i], z[i]));
+  }
+}
+
+bool CollisionObject::sweep(const Vector3D &from, const Vector3D &to, Vector3D &contact) {
+  Vector3D dir = to - from;
+  double length = dir.norm();
+  if (length == 0) return false;
+  dir /= length;
+
+  // Advancing by the distance to the surface never steps through it
+  double t = 0;
+  for (int i = 0; i < SWEEP_ITERATIONS; i++) {
+    Vector3D p = from + t * dir;
+    double d = distance(p);
+    if (d < SWEEP_TOLERANCE) {
+      contact = p;
+      return true;
+    }
+    t += d;
+    if (t >= length) return false;
+  }
+  return false;
+}
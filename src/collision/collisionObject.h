@@ -11,9 +11,32 @@ using namespace nanogui;
 
 class CollisionObject {
 public:
+  virtual ~CollisionObject() {}
+
   virtual void render(GLShader &shader) = 0;
+
+  // Moves pm out of the object if it entered it anywhere along the step
+  // from its last position
   virtual void collide(PointMass &pm) = 0;
 
+  // Same for the edge between two particles that both stay outside
+  virtual void collideEdge(PointMass &a, PointMass &b) {}
+
+  // Signed distance to the surface, negative inside
+  virtual double distance(const Vector3D &p) = 0;
+
+  // Signed distances of n points given as coordinate arrays
+  virtual void distances(const double *x, const double *y, const double *z, int n,
+                         double *out);
+
+  // Axis aligned box around the object, false if it is unbounded
+  virtual bool bounds(Vector3D &min, Vector3D &max) { return false; }
+
+protected:
+  // First point where the segment from -> to touches the surface, found by
+  // advancing along it by the distance to the surface
+  bool sweep(const Vector3D &from, const Vector3D &to, Vector3D &contact);
+
 private:
   double friction;
 };
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <math.h>
+#include <nanogui/nanogui.h>
+
+#include "../clothMesh.h"
+#include "obb.h"
+
+using namespace nanogui;
+using namespace CGL;
+
+OBB::OBB(const Vector3D &center, const Vector3D &x_axis, const Vector3D &y_axis,
+         const Vector3D &half_extents, double friction)
+    : center(center), half_extents(half_extents), friction(friction) {
+  // Orthonormal, whatever the scene file gave
+  axes[0] = x_axis.unit();
+  axes[1] = (y_axis - dot(y_axis, axes[0]) * axes[0]).unit();
+  axes[2] = cross(axes[0], axes[1]);
+}
+
+void OBB::collide(PointMass &pm) {
+  Vector3D p = pm.position - center;
+  Vector3D q(dot(p, axes[0]), dot(p, axes[1]), dot(p, axes[2]));
+
+  // Inside if within the half extents on all three axes; then out through
+  // the face it is closest to
+  int face = 0;
+  double depth = -1;
+  for (int k = 0; k < 3; k++) {
+    double d = fabs(q[k]) - half_extents[k];
+    if (d >= 0) {
+      face = -1;
+      break;
+    }
+    if (depth < 0 || -d < depth) {
+      depth = -d;
+      face = k;
+    }
+  }
+
+  Vector3D surface_point;
+  if (face >= 0) {
+    surface_point = pm.position + (q[face] >= 0 ? depth : -depth) * axes[face];
+  } else if (!sweep(pm.last_position, pm.position, surface_point)) {
+    return;
+  }
+
+  pm.position = pm.last_position + (1.0 - friction) * (surface_point - pm.last_position);
+}
+
+void OBB::collideEdge(PointMass &a, PointMass &b) {
+  // Clip the edge a + t * edge to the slab of each axis; what is left of
+  // [0, 1] is the part inside the box
+  Vector3D edge = b.position - a.position;
+  Vector3D p = a.position - center;
+  double t0 = 0, t1 = 1;
+  for (int k = 0; k < 3; k++) {
+    double q = dot(p, axes[k]), dq = dot(edge, axes[k]);
+    if (dq == 0) {
+      if (fabs(q) >= half_extents[k]) return;
+      continue;
+    }
+    double enter = (-half_extents[k] - q) / dq, leave = (half_extents[k] - q) / dq;
+    if (enter > leave) swap(enter, leave);
+    t0 = std::max(t0, enter);
+    t1 = std::min(t1, leave);
+    if (t0 >= t1) return;
+  }
+  if (t0 <= 0 || t1 >= 1) return;
+
+  // Push the middle of that part out through its nearest face, each end by
+  // its share of the lever like Sphere::collideEdge
+  double t = 0.5 * (t0 + t1);
+  Vector3D m = p + t * edge;
+  Vector3D push;
+  double depth = -1;
+  for (int k = 0; k < 3; k++) {
+    double q = dot(m, axes[k]);
+    double d = half_extents[k] - fabs(q);
+    if (depth < 0 || d < depth) {
+      depth = d;
+      push = (q >= 0 ? d : -d) * axes[k];
+    }
+  }
+
+  double wa = a.pinned ? 0.0 : 1.0 - t, wb = b.pinned ? 0.0 : t;
+  double w2 = wa * wa + wb * wb;
+  if (w2 == 0) return;
+  a.position += push * (wa / w2);
+  b.position += push * (wb / w2);
+}
+
+double OBB::distance(const Vector3D &p) {
+  double result;
+  distances(&p.x, &p.y, &p.z, 1, &result);
+  return result;
+}
+
+void OBB::distances(const double *x, const double *y, const double *z, int n, double *out) {
+  double cx = center.x, cy = center.y, cz = center.z;
+  double ux = axes[0].x, uy = axes[0].y, uz = axes[0].z;
+  double vx = axes[1].x, vy = axes[1].y, vz = axes[1].z;
+  double wx = axes[2].x, wy = axes[2].y, wz = axes[2].z;
+  double hx = half_extents.x, hy = half_extents.y, hz = half_extents.z;
+
+  // Distance outside plus the (negative) depth inside, both without branches
+#pragma omp simd
+  for (int i = 0; i < n; i++) {
+    double px = x[i] - cx, py = y[i] - cy, pz = z[i] - cz;
+    double dx = fabs(px * ux + py * uy + pz * uz) - hx;
+    double dy = fabs(px * vx + py * vy + pz * vz) - hy;
+    double dz = fabs(px * wx + py * wy + pz * wz) - hz;
+    double ox = std::max(dx, 0.0), oy = std::max(dy, 0.0), oz = std::max(dz, 0.0);
+    double inside = std::min(std::max(dx, std::max(dy, dz)), 0.0);
+    out[i] = sqrt(ox * ox + oy * oy + oz * oz) + inside;
+  }
+}
+
+bool OBB::bounds(Vector3D &min, Vector3D &max) {
+  for (int k = 0; k < 3; k++) {
+    double r = 0;
+    for (int a = 0; a < 3; a++) {
+      r += fabs(axes[a][k]) * half_extents[a];
+    }
+    min[k] = center[k] - r;
+    max[k] = center[k] + r;
+  }
+  return true;
+}
+
+void OBB::render(GLShader &shader) {
+  nanogui::Color color(0.7f, 0.7f, 0.7f, 1.0f);
+
+  Matrix4f model;
+  model.setIdentity();
+  shader.setUniform("model", model);
+
+  // Two triangles per face, the faces along -axis and +axis of each axis
+  MatrixXf positions(3, 36);
+  MatrixXf normals(3, 36);
+  int col = 0;
+  for (int a = 0; a < 3; a++) {
+    Vector3D u = axes[(a + 1) % 3] * half_extents[(a + 1) % 3];
+    Vector3D v = axes[(a + 2) % 3] * half_extents[(a + 2) % 3];
+    for (double side : {-1.0, 1.0}) {
+      Vector3D n = side * axes[a];
+      Vector3D c = center + n * half_extents[a];
+      Vector3D corners[6] = {c - u - v, c + u - v, c + u + v, c + u + v, c - u + v, c - u - v};
+      for (int k = 0; k < 6; k++) {
+        positions.col(col) << corners[k].x, corners[k].y, corners[k].z;
+        normals.col(col) << n.x, n.y, n.z;
+        col++;
+      }
+    }
+  }
+
+  if (shader.uniform("in_color", false) != -1) {
+    shader.setUniform("in_color", color);
+  }
+  shader.uploadAttrib("in_position", positions);
+  shader.uploadAttrib("in_normal", normals);
+  shader.drawArray(GL_TRIANGLES, 0, 36);
+}
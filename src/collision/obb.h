@@ -0,0 +1,31 @@
+#ifndef COLLISIONOBJECT_OBB_H
+#define COLLISIONOBJECT_OBB_H
+
+#include "../clothMesh.h"
+#include "collisionObject.h"
+
+using namespace CGL;
+using namespace std;
+
+// Oriented box: center, three orthonormal axes and the half size along each
+struct OBB : public CollisionObject {
+public:
+  OBB(const Vector3D &center, const Vector3D &x_axis, const Vector3D &y_axis,
+      const Vector3D &half_extents, double friction);
+
+  void render(GLShader &shader);
+  void collide(PointMass &pm);
+  void collideEdge(PointMass &a, PointMass &b);
+  double distance(const Vector3D &p);
+  void distances(const double *x, const double *y, const double *z, int n, double *out);
+  bool bounds(Vector3D &min, Vector3D &max);
+
+private:
+  Vector3D center;
+  Vector3D axes[3];
+  Vector3D half_extents;
+
+  double friction;
+};
+
+#endif /* COLLISIONOBJECT_OBB_H */
@@ -10,9 +10,23 @@ using namespace CGL;
 
 #define SURFACE_OFFSET 0.0001
 
+// The test is on the whole step already: a particle that changed sides
+// crossed the plane somewhere, however thin and however fast
 void Plane::collide(PointMass &pm) {
-  // TODO (Part 3): Handle collisions with planes.
+  double last_side = dot(pm.last_position - point, normal);
+  double side = dot(pm.position - point, normal);
+  if ((last_side >= 0) == (side >= 0)) return;
+
+  // Crossed during the step: stop just short of the plane on the side the
+  // particle came from, less the motion friction takes away
+  Vector3D tangent_point = pm.position - side * normal;
+  Vector3D offset = (last_side >= 0 ? SURFACE_OFFSET : -SURFACE_OFFSET) * normal;
+  Vector3D correction = tangent_point + offset - pm.last_position;
+  pm.position = pm.last_position + (1.0 - friction) * correction;
+}
 
+double Plane::distance(const Vector3D &p) {
+  return dot(p - point, normal);
 }
 
 void Plane::render(GLShader &shader) {
@@ -17,6 +17,7 @@ public:
 
   void render(GLShader &shader);
   void collide(PointMass &pm);
+  double distance(const Vector3D &p);
 
   Vector3D point;
   Vector3D normal;
@@ -8,8 +8,79 @@ using namespace nanogui;
 using namespace CGL;
 
 void Sphere::collide(PointMass &pm) {
-  // TODO (Part 3): Handle collisions with spheres.
+  Vector3D d = pm.position - origin;
+  if (d.norm2() < radius2) {
+    // Move to where the particle would have touched the surface, keeping
+    // only the part of the motion friction lets through
+    Vector3D tangent_point = origin + d.unit() * radius;
+    Vector3D correction = tangent_point - pm.last_position;
+    pm.position = pm.last_position + (1.0 - friction) * correction;
+    return;
+  }
 
+  // Ends outside. Unless it started outside and the step is longer than
+  // the distance it started from, it cannot have passed through
+  Vector3D motion = pm.position - pm.last_position;
+  double clearance = distance(pm.last_position);
+  double motion2 = motion.norm2();
+  if (clearance <= 0 || motion2 <= clearance * clearance) return;
+
+  // First time of contact along the step, from
+  // |last - origin + t * motion|^2 = radius^2
+  Vector3D from = pm.last_position - origin;
+  double b = dot(motion, from);
+  double c = from.norm2() - radius2;
+  double disc = b * b - motion2 * c;
+  if (b >= 0 || disc < 0) return;
+  double t = (-b - sqrt(disc)) / motion2;
+  if (t > 1) return;
+
+  // Tunnelled through: stop where it entered
+  Vector3D contact = pm.last_position + t * motion;
+  pm.position = pm.last_position + (1.0 - friction) * (contact - pm.last_position);
+}
+
+void Sphere::collideEdge(PointMass &a, PointMass &b) {
+  // Closest point of the edge to the center
+  Vector3D edge = b.position - a.position;
+  double length2 = edge.norm2();
+  if (length2 == 0) return;
+  double t = dot(origin - a.position, edge) / length2;
+  if (t <= 0 || t >= 1) return;
+
+  Vector3D closest = a.position + t * edge;
+  Vector3D d = closest - origin;
+  double d2 = d.norm2();
+  if (d2 >= radius2 || d2 == 0) return;
+
+  // Push the edge out at that point, each end by its share of the lever
+  Vector3D push = d * (radius / sqrt(d2) - 1.0);
+  double wa = a.pinned ? 0.0 : 1.0 - t, wb = b.pinned ? 0.0 : t;
+  double w2 = wa * wa + wb * wb;
+  if (w2 == 0) return;
+  a.position += push * (wa / w2);
+  b.position += push * (wb / w2);
+}
+
+double Sphere::distance(const Vector3D &p) {
+  return (p - origin).norm() - radius;
+}
+
+void Sphere::distances(const double *x, const double *y, const double *z, int n,
+                       double *out) {
+  double ox = origin.x, oy = origin.y, oz = origin.z;
+#pragma omp simd
+  for (int i = 0; i < n; i++) {
+    double dx = x[i] - ox, dy = y[i] - oy, dz = z[i] - oz;
+    out[i] = sqrt(dx * dx + dy * dy + dz * dz) - radius;
+  }
+}
+
+bool Sphere::bounds(Vector3D &min, Vector3D &max) {
+  Vector3D r(radius, radius, radius);
+  min = origin - r;
+  max = origin + r;
+  return true;
 }
 
 void Sphere::render(GLShader &shader) {
@@ -15,6 +15,10 @@ public:
 
   void render(GLShader &shader);
   void collide(PointMass &pm);
+  void collideEdge(PointMass &a, PointMass &b);
+  double distance(const Vector3D &p);
+  void distances(const double *x, const double *y, const double *z, int n, double *out);
+  bool bounds(Vector3D &min, Vector3D &max);
 
 private:
   Vector3D origin;
@@ -0,0 +1,334 @@
+#include <math.h>
+
+#include "elasticRod.h"
+#include "bandedSolver.h"
+#include "HairVector.h"
+
+using namespace std;
+
+void ElasticRods::bind(Hair *hair, RodState &rod) {
+  vector<PointMass> &pms = hair->point_masses;
+  int n = pms.size();
+
+  rod.rest_length.assign(n - 1, 0.0);
+  rod.tangent.assign(n - 1, Vector3D());
+  rod.material_d1.assign(n - 1, Vector3D());
+  rod.voronoi_length.assign(n, 0.0);
+  rod.twist.assign(n, 0.0);
+  rod.kappa_bar_1.assign(n, 0.0);
+  rod.kappa_bar_2.assign(n, 0.0);
+
+  for (int j = 0; j < n - 1; j++) {
+    Vector3D e = pms[j+1].start_position - pms[j].start_position;
+    rod.rest_length[j] = e.norm();
+    rod.tangent[j] = e / rod.rest_length[j];
+  }
+
+  // Material frames transported along the rest shape, so the rest twist is 0
+  Vector3D t = rod.tangent[0];
+  Vector3D axis = fabs(t.x) < 0.9 ? Vector3D(1, 0, 0) : Vector3D(0, 1, 0);
+  rod.material_d1[0] = cross(t, axis).unit();
+  for (int j = 1; j < n - 1; j++) {
+    rod.material_d1[j] = parallelTransport(rod.material_d1[j-1], rod.tangent[j-1], rod.tangent[j]).unit();
+  }
+
+  for (int i = 1; i < n - 1; i++) {
+    rod.voronoi_length[i] = 0.5 * (rod.rest_length[i-1] + rod.rest_length[i]);
+
+    const Vector3D &te = rod.tangent[i-1], &tf = rod.tangent[i];
+    Vector3D kb = 2.0 * cross(te, tf) / (1.0 + dot(te, tf));
+    const Vector3D &m1e = rod.material_d1[i-1], &m1f = rod.material_d1[i];
+    Vector3D m2e = cross(te, m1e), m2f = cross(tf, m1f);
+    rod.kappa_bar_1[i] = 0.5 * dot(kb, m2e + m2f);
+    rod.kappa_bar_2[i] = -0.5 * dot(kb, m1e + m1f);
+  }
+}
+
+void ElasticRods::updateFrames(Hair *hair, RodState &rod) {
+  vector<PointMass> &pms = hair->point_masses;
+
+  for (int j = 0; j < n - 1; j++) {
+    Vector3D e = pms[j+1].position - pms[j].position;
+    edge_length[j] = e.norm();
+    Vector3D t = e / edge_length[j];
+
+    // Transporting the material frame in time leaves its angle about the
+    // tangent unchanged, the twist solve then rotates it
+    Vector3D d1 = parallelTransport(rod.material_d1[j], rod.tangent[j], t);
+    d1 = (d1 - dot(d1, t) * t).unit();
+    rod.material_d1[j] = d1;
+    rod.tangent[j] = t;
+    m2[j] = cross(t, d1);
+  }
+
+  for (int i = 1; i < n - 1; i++) {
+    const Vector3D &te = rod.tangent[i-1], &tf = rod.tangent[i];
+    double chi = max(1.0 + dot(te, tf), 1e-6);
+    curvature_binormal[i] = 2.0 * cross(te, tf) / chi;
+
+    // Twist is the angle from the space transported frame of the previous
+    // edge to the frame of this edge, unwrapped against its last value
+    const Vector3D &d1 = rod.material_d1[i];
+    Vector3D u = parallelTransport(rod.material_d1[i-1], te, tf);
+    double angle = atan2(dot(cross(u, d1), tf), dot(u, d1));
+    double delta = angle - rod.twist[i];
+    while (delta > PI) delta -= 2.0 * PI;
+    while (delta < -PI) delta += 2.0 * PI;
+    rod.twist[i] += delta;
+  }
+}
+
+void ElasticRods::materialCurvature(RodState &rod, int i, double &kappa_1, double &kappa_2) {
+  const Vector3D &kb = curvature_binormal[i];
+  kappa_1 = 0.5 * dot(kb, m2[i-1] + m2[i]);
+  kappa_2 = -0.5 * dot(kb, rod.material_d1[i-1] + rod.material_d1[i]);
+}
+
+void ElasticRods::solveTwist(RodState &rod) {
+  // Newton step on the rotations of the frames of edges 1 .. n - 2, the
+  // root edge is clamped. Bending contributes through its Gauss-Newton
+  // Hessian.
+  int k = n - 2;
+  if (k <= 0) return;
+
+  band_0.assign(k, 1e-9 * (bending + twisting) + 1e-12);
+  band_1.assign(k, 0.0);
+  rhs_x.assign(k, 0.0);
+
+  for (int i = 1; i < n - 1; i++) {
+    double c_b = bending / rod.voronoi_length[i];
+    double c_t = twisting / rod.voronoi_length[i];
+
+    double kappa_1, kappa_2;
+    materialCurvature(rod, i, kappa_1, kappa_2);
+    double d_1 = kappa_1 - rod.kappa_bar_1[i];
+    double d_2 = kappa_2 - rod.kappa_bar_2[i];
+
+    const Vector3D &kb = curvature_binormal[i];
+    double dk1_e = -0.5 * dot(kb, rod.material_d1[i-1]), dk1_f = -0.5 * dot(kb, rod.material_d1[i]);
+    double dk2_e = -0.5 * dot(kb, m2[i-1]), dk2_f = -0.5 * dot(kb, m2[i]);
+    double tau = rod.twist[i];
+
+    int e = i - 2, f = i - 1;
+    if (e >= 0) {
+      rhs_x[e] -= c_b * (d_1 * dk1_e + d_2 * dk2_e) - c_t * tau;
+      band_0[e] += c_b * (dk1_e * dk1_e + dk2_e * dk2_e) + c_t;
+      band_1[e] += c_b * (dk1_e * dk1_f + dk2_e * dk2_f) - c_t;
+    }
+    rhs_x[f] -= c_b * (d_1 * dk1_f + d_2 * dk2_f) + c_t * tau;
+    band_0[f] += c_b * (dk1_f * dk1_f + dk2_f * dk2_f) + c_t;
+  }
+
+  solveSymmetricTridiagonal(k, 1, band_0.data(), band_1.data(), rhs_x.data());
+
+  // The steps are small, so rotate with the series of cos and sin and
+  // renormalize
+  double last = 0;
+  for (int j = 1; j < n - 1; j++) {
+    double phi = rhs_x[j-1];
+    double c = 1.0 - 0.5 * phi * phi, s = phi - phi * phi * phi / 6.0;
+    rod.material_d1[j] = (c * rod.material_d1[j] + s * m2[j]).unit();
+    rod.twist[j] += phi - last;
+    last = phi;
+  }
+}
+
+RodState &ElasticRods::strand(Hair *hair, int index) {
+  if ((int) rods.size() <= index) rods.resize(index + 1);
+  RodState &rod = rods[index];
+
+  // Also rebinds strands resampled by the level of detail
+  if (rod.rest_length.size() + 1 != hair->point_masses.size()) bind(hair, rod);
+  return rod;
+}
+
+void ElasticRods::reset(HairVector *hairs) {
+  rods.clear();
+}
+
+void ElasticRods::exportState(Hair *hair, int index, vector<double> &state) {
+  StrandSolver::exportState(hair, index, state);
+
+  RodState &rod = strand(hair, index);
+  for (int j = 0; j < rod.tangent.size(); j++) {
+    const Vector3D &t = rod.tangent[j], &d1 = rod.material_d1[j];
+    state.insert(state.end(), {t.x, t.y, t.z, d1.x, d1.y, d1.z});
+  }
+  state.insert(state.end(), rod.twist.begin(), rod.twist.end());
+}
+
+size_t ElasticRods::importState(Hair *hair, int index, const vector<double> &state, size_t offset) {
+  offset = StrandSolver::importState(hair, index, state, offset);
+
+  RodState &rod = strand(hair, index);
+  for (int j = 0; j < rod.tangent.size(); j++) {
+    const double *v = &state[offset];
+    rod.tangent[j] = Vector3D(v[0], v[1], v[2]);
+    rod.material_d1[j] = Vector3D(v[3], v[4], v[5]);
+    offset += 6;
+  }
+  for (int i = 0; i < rod.twist.size(); i++) {
+    rod.twist[i] = state[offset++];
+  }
+  return offset;
+}
+
+// Positions, a frame per edge and a twist per vertex
+size_t ElasticRods::stateSize(int particles) {
+  size_t edges = particles > 0 ? particles - 1 : 0;
+  return StrandSolver::stateSize(particles) + edges * 6 + particles;
+}
+
+void ElasticRods::step(HairVector *hairs, Hair *hair, int index,
+                       double frames_per_sec, double simulation_steps) {
+  vector<PointMass> &pms = hair->point_masses;
+  n = pms.size();
+  if (n < 2) return;
+
+  double delta_t = 1.0f / frames_per_sec / simulation_steps;
+  double mass = hair->length * hairs->density / hair->particles_count;
+  double damping = hairs->damping;
+  RodState &rod = strand(hair, index);
+
+  edge_length.resize(n - 1);
+  curvature_binormal.resize(n);
+  m2.resize(n - 1);
+
+  // Clamp the root edge, it turns with the bone the root is animated by
+  fixed.assign(n, 0);
+  for (int i = 0; i < n; i++) {
+    fixed[i] = pms[i].pinned;
+  }
+  if (pms[0].pinned && n > 2) {
+    PointMass &pm = pms[1];
+    pm.last_position = pm.position;
+    pm.position = pms[0].position +
+                  hair->root_rotation * (pm.start_position - pms[0].start_position);
+    fixed[1] = true;
+  }
+
+  updateFrames(hair, rod);
+
+  force.resize(n);
+  for (int i = 0; i < n; i++) {
+    force[i] = pms[i].forces;
+  }
+
+  for (int j = 0; j < n - 1; j++) {
+    Vector3D f = (stretching * (edge_length[j] / rod.rest_length[j] - 1.0)) * rod.tangent[j];
+    force[j] += f;
+    force[j+1] -= f;
+  }
+
+  // Bending and twisting forces from the gradients of the material
+  // curvature and of the twist with respect to the two edges
+  for (int i = 1; i < n - 1; i++) {
+    const Vector3D &te = rod.tangent[i-1], &tf = rod.tangent[i];
+    const Vector3D &kb = curvature_binormal[i];
+    double chi = max(1.0 + dot(te, tf), 1e-6);
+    Vector3D tilde_t = (te + tf) / chi;
+    Vector3D tilde_d1 = (rod.material_d1[i-1] + rod.material_d1[i]) / chi;
+    Vector3D tilde_d2 = (m2[i-1] + m2[i]) / chi;
+
+    double kappa_1, kappa_2;
+    materialCurvature(rod, i, kappa_1, kappa_2);
+    double c_b = bending / rod.voronoi_length[i];
+    double d_1 = c_b * (kappa_1 - rod.kappa_bar_1[i]);
+    double d_2 = c_b * (kappa_2 - rod.kappa_bar_2[i]);
+    double tau = twisting / rod.voronoi_length[i] * rod.twist[i];
+
+    Vector3D grad_e = (d_1 * (-kappa_1 * tilde_t + cross(tf, tilde_d2)) +
+                       d_2 * (-kappa_2 * tilde_t - cross(tf, tilde_d1)) +
+                       (0.5 * tau) * kb) / edge_length[i-1];
+    Vector3D grad_f = (d_1 * (-kappa_1 * tilde_t - cross(te, tilde_d2)) +
+                       d_2 * (-kappa_2 * tilde_t + cross(te, tilde_d1)) +
+                       (0.5 * tau) * kb) / edge_length[i];
+
+    force[i-1] += grad_e;
+    force[i] -= grad_e - grad_f;
+    force[i+1] -= grad_f;
+  }
+
+  // The material frames are quasi-static, their update is seen by the next
+  // step
+  solveTwist(rod);
+
+  // (M + h^2 K) v' = M v + h F, with K the stretch Laplacian plus the
+  // bending bi-Laplacian. Fixed particles keep their velocity and move to
+  // the right hand side.
+  double h2 = delta_t * delta_t;
+  band_0.assign(n, mass);
+  band_1.assign(n, 0.0);
+  band_2.assign(n, 0.0);
+  rhs_x.resize(n);
+  rhs_y.resize(n);
+  rhs_z.resize(n);
+
+  velocity.resize(n);
+  for (int i = 0; i < n; i++) {
+    velocity[i] = pms[i].velocity(delta_t);
+    if (fixed[i]) band_0[i] = 1.0;
+    Vector3D r = fixed[i] ? velocity[i] : mass * velocity[i] + delta_t * force[i];
+    rhs_x[i] = r.x;
+    rhs_y[i] = r.y;
+    rhs_z[i] = r.z;
+  }
+
+  // Adds value at (p, q) and (q, p), p <= q
+  auto couple = [&](int p, int q, double value) {
+    if (p == q) {
+      if (!fixed[p]) band_0[p] += value;
+    } else if (!fixed[p] && !fixed[q]) {
+      (q - p == 1 ? band_1 : band_2)[p] += value;
+    } else if (!fixed[p]) {
+      rhs_x[p] -= value * velocity[q].x;
+      rhs_y[p] -= value * velocity[q].y;
+      rhs_z[p] -= value * velocity[q].z;
+    } else if (!fixed[q]) {
+      rhs_x[q] -= value * velocity[p].x;
+      rhs_y[q] -= value * velocity[p].y;
+      rhs_z[q] -= value * velocity[p].z;
+    }
+  };
+
+  for (int j = 0; j < n - 1; j++) {
+    double k = h2 * stretching / rod.rest_length[j];
+    couple(j, j, k);
+    couple(j + 1, j + 1, k);
+    couple(j, j + 1, -k);
+  }
+
+  for (int i = 1; i < n - 1; i++) {
+    double k = h2 * bending / (rod.voronoi_length[i] * rod.rest_length[i-1] * rod.rest_length[i]);
+    couple(i - 1, i - 1, k);
+    couple(i, i, 4.0 * k);
+    couple(i + 1, i + 1, k);
+    couple(i - 1, i, -2.0 * k);
+    couple(i, i + 1, -2.0 * k);
+    couple(i - 1, i + 1, k);
+  }
+
+  factorPentadiagonal(n, 1, band_0.data(), band_1.data(), band_2.data());
+  solvePentadiagonal(n, 1, band_0.data(), band_1.data(), band_2.data(),
+                     rhs_x.data(), rhs_y.data(), rhs_z.data());
+
+  for (int i = 0; i < n; i++) {
+    PointMass &pm = pms[i];
+    if (fixed[i]) continue;
+    Vector3D v = (1.0 - damping / 100.0) * Vector3D(rhs_x[i], rhs_y[i], rhs_z[i]);
+    pm.last_position = pm.position;
+    pm.position += v * delta_t;
+  }
+
+  // Same 10% strain limit as the spring model as a safeguard, swept from the
+  // root so each correction only moves particles further out
+  for (int j = 0; j < n - 1; j++) {
+    PointMass &pm = pms[j+1];
+    if (fixed[j+1]) continue;
+    Vector3D e = pm.position - pms[j].position;
+    double length = e.norm();
+    if (length > 1.1 * rod.rest_length[j]) {
+      pm.position = pms[j].position + e * (1.1 * rod.rest_length[j] / length);
+    }
+  }
+}
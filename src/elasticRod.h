@@ -0,0 +1,83 @@
+#ifndef CLOTHSIM_ELASTICROD_H
+#define CLOTHSIM_ELASTICROD_H
+
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "hair.h"
+#include "strandSolver.h"
+
+using namespace CGL;
+using namespace std;
+
+// Per strand state of the rod model, edge j joins particles j and j + 1
+struct RodState {
+  // rest shape
+  vector<double> rest_length;    // per edge
+  vector<double> voronoi_length; // per interior vertex
+  vector<double> kappa_bar_1;    // rest material curvature, per vertex
+  vector<double> kappa_bar_2;
+
+  // material frame of each edge, transported in time with the edge
+  vector<Vector3D> tangent;
+  vector<Vector3D> material_d1;
+
+  // twist of the material frame from the previous edge, per vertex
+  vector<double> twist;
+};
+
+/**
+ * Discrete elastic rods (Bergou et al. 2008, 2010) as an alternative to the
+ * spring model. Each edge carries a material frame, so the strands resist
+ * bending against their rest curvature and twisting about their centerline.
+ * The frames are parallel transported in time and only turn about their
+ * edges in the twist solve, which makes them their own reference frames.
+ *
+ * Twist waves are much faster than the motion of the centerline, so the
+ * frames are kept quasi-static with one Newton step on a tridiagonal
+ * system per substep. The centerline is advanced with a linearly implicit
+ * Euler step, approximating the Hessian by the stretch Laplacian plus the
+ * bending bi-Laplacian, which gives one pentadiagonal factorization per
+ * strand. The root edge is clamped: it follows the root without turning.
+ */
+class ElasticRods : public StrandSolver {
+public:
+  string name() { return "elastic rod"; }
+
+  void step(HairVector *hairs, Hair *hair, int index,
+            double frames_per_sec, double simulation_steps);
+  void reset(HairVector *hairs);
+
+  // Adds the material frames and twist to the positions
+  void exportState(Hair *hair, int index, vector<double> &state);
+  size_t importState(Hair *hair, int index, const vector<double> &state, size_t offset);
+  size_t stateSize(int particles);
+
+  // Builds the rest state of a strand from its start positions.
+  void bind(Hair *hair, RodState &rod);
+
+  vector<RodState> rods;
+
+  double stretching = 1e9; // stretching stiffness
+  double bending = 1e9;    // bending stiffness
+  double twisting = 1e9;   // twisting stiffness
+
+private:
+  RodState &strand(Hair *hair, int index);
+  void updateFrames(Hair *hair, RodState &rod);
+  void materialCurvature(RodState &rod, int i, double &kappa_1, double &kappa_2);
+  void solveTwist(RodState &rod);
+
+  // Scratch, reused across strands
+  int n = 0;
+  vector<char> fixed;
+  vector<double> edge_length;
+  vector<Vector3D> curvature_binormal;
+  vector<Vector3D> m2;
+  vector<Vector3D> force;
+  vector<Vector3D> velocity;
+  vector<double> band_0, band_1, band_2;
+  vector<double> rhs_x, rhs_y, rhs_z;
+};
+
+#endif //CLOTHSIM_ELASTICROD_H
@@ -0,0 +1,224 @@
+#include <math.h>
+
+#include "forceField.h"
+
+using namespace std;
+
+// Lattice value in [-1, 1] for integer coordinates
+static double latticeValue(int x, int y, int z, int seed) {
+  unsigned int h = (unsigned int) (x * 73856093) ^ (unsigned int) (y * 19349663) ^
+                   (unsigned int) (z * 83492791) ^ (unsigned int) (seed * 2654435761u);
+  h ^= h >> 13;
+  h *= 0x5bd1e995;
+  h ^= h >> 15;
+  return (h & 0xffffff) / (double) 0x7fffff - 1.0;
+}
+
+static double smooth(double t) {
+  return t * t * (3.0 - 2.0 * t);
+}
+
+// Smoothly interpolated value noise
+static double valueNoise(const Vector3D &p, int seed) {
+  int x0 = (int) floor(p.x), y0 = (int) floor(p.y), z0 = (int) floor(p.z);
+  double tx = smooth(p.x - x0), ty = smooth(p.y - y0), tz = smooth(p.z - z0);
+
+  double v = 0;
+  for (int k = 0; k < 2; k++) {
+    for (int j = 0; j < 2; j++) {
+      for (int i = 0; i < 2; i++) {
+        double w = (i ? tx : 1.0 - tx) * (j ? ty : 1.0 - ty) * (k ? tz : 1.0 - tz);
+        v += w * latticeValue(x0 + i, y0 + j, z0 + k, seed);
+      }
+    }
+  }
+  return v;
+}
+
+void ForceFields::update(HairVector *hairs, double time) {
+  has_turbulence = false;
+  for (ForceField &f : fields) {
+    if (f.type == TURBULENCE) has_turbulence = true;
+  }
+  if (!has_turbulence) return;
+
+  bool stale = !built || time - last_refresh >= refresh_interval;
+
+  // Rebuild early if the hair has left the grid
+  if (!stale) {
+    for (Hair *hair : *hairs->hair_vector) {
+      for (PointMass &pm : hair->point_masses) {
+        const Vector3D &p = pm.position;
+        if (p.x < grid_min.x || p.y < grid_min.y || p.z < grid_min.z ||
+            p.x > grid_max.x || p.y > grid_max.y || p.z > grid_max.z) {
+          stale = true;
+          break;
+        }
+      }
+      if (stale) break;
+    }
+  }
+
+  if (stale) {
+    buildGrid(hairs, time);
+  }
+}
+
+void ForceFields::buildGrid(HairVector *hairs, double time) {
+  Vector3D lo(INF_D), hi(-INF_D);
+  for (Hair *hair : *hairs->hair_vector) {
+    for (PointMass &pm : hair->point_masses) {
+      const Vector3D &p = pm.position;
+      lo = Vector3D(min(lo.x, p.x), min(lo.y, p.y), min(lo.z, p.z));
+      hi = Vector3D(max(hi.x, p.x), max(hi.y, p.y), max(hi.z, p.z));
+    }
+  }
+
+  // Pad by a fifth of the extent so moving hair stays inside for a while
+  Vector3D extent = hi - lo;
+  double size = max(max(extent.x, extent.y), max(extent.z, 1e-6));
+  lo -= Vector3D(0.2 * size);
+  hi += Vector3D(0.2 * size);
+  size *= 1.4;
+
+  cell = size / (grid_resolution - 1);
+  nx = (int) ceil((hi.x - lo.x) / cell) + 1;
+  ny = (int) ceil((hi.y - lo.y) / cell) + 1;
+  nz = (int) ceil((hi.z - lo.z) / cell) + 1;
+  grid_min = lo;
+  fillGrid(time);
+}
+
+bool ForceFields::cacheState(double &refresh_time, Vector3D &min, double &cell_size, int *size) {
+  refresh_time = last_refresh;
+  min = grid_min;
+  cell_size = cell;
+  size[0] = nx;
+  size[1] = ny;
+  size[2] = nz;
+  return built;
+}
+
+void ForceFields::restoreCache(bool was_built, double refresh_time, const Vector3D &min,
+                               double cell_size, const int *size) {
+  built = false;
+  if (!was_built) return;
+
+  has_turbulence = false;
+  for (ForceField &f : fields) {
+    if (f.type == TURBULENCE) has_turbulence = true;
+  }
+  if (!has_turbulence || size[0] < 1 || size[1] < 1 || size[2] < 1 || !(cell_size > 0)) return;
+
+  grid_min = min;
+  cell = cell_size;
+  nx = size[0];
+  ny = size[1];
+  nz = size[2];
+  fillGrid(refresh_time);
+}
+
+// Samples the fields as of time on the nodes of the grid placed at
+// grid_min
+void ForceFields::fillGrid(double time) {
+  grid_max = grid_min + Vector3D(nx - 1, ny - 1, nz - 1) * cell;
+
+  grid_x.assign(nx * ny * nz, 0.0);
+  grid_y.assign(nx * ny * nz, 0.0);
+  grid_z.assign(nx * ny * nz, 0.0);
+
+  for (ForceField &f : fields) {
+    if (f.type != TURBULENCE) continue;
+
+    // Vector potential on the nodes plus a layer of ghost nodes, so the
+    // curl can use central differences everywhere
+    int px = nx + 2, py = ny + 2, pz = nz + 2;
+    vector<Vector3D> potential(px * py * pz);
+    Vector3D drift = f.direction * (f.speed * time);
+    for (int k = 0; k < pz; k++) {
+      for (int j = 0; j < py; j++) {
+        for (int i = 0; i < px; i++) {
+          Vector3D p = (grid_min + Vector3D(i - 1, j - 1, k - 1) * cell - f.center - drift) * f.frequency;
+          potential[(k * py + j) * px + i] =
+              Vector3D(valueNoise(p, 0), valueNoise(p, 1), valueNoise(p, 2));
+        }
+      }
+    }
+
+    // Noise varies by about one unit per 1 / frequency, so this scales the
+    // curl to roughly the field strength
+    double scale = f.strength / (2.0 * cell * f.frequency);
+    for (int k = 0; k < nz; k++) {
+      for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+          int c = ((k + 1) * py + (j + 1)) * px + (i + 1);
+          const Vector3D &xp = potential[c + 1], &xm = potential[c - 1];
+          const Vector3D &yp = potential[c + px], &ym = potential[c - px];
+          const Vector3D &zp = potential[c + px * py], &zm = potential[c - px * py];
+
+          int g = (k * ny + j) * nx + i;
+          grid_x[g] += scale * ((yp.z - ym.z) - (zp.y - zm.y));
+          grid_y[g] += scale * ((zp.x - zm.x) - (xp.z - xm.z));
+          grid_z[g] += scale * ((xp.y - xm.y) - (yp.x - ym.x));
+        }
+      }
+    }
+  }
+
+  last_refresh = time;
+  built = true;
+}
+
+Vector3D ForceFields::turbulence(const Vector3D &p) {
+  double fx = min(max((p.x - grid_min.x) / cell, 0.0), nx - 1.000001);
+  double fy = min(max((p.y - grid_min.y) / cell, 0.0), ny - 1.000001);
+  double fz = min(max((p.z - grid_min.z) / cell, 0.0), nz - 1.000001);
+  int i = (int) fx, j = (int) fy, k = (int) fz;
+  double tx = fx - i, ty = fy - j, tz = fz - k;
+
+  int g = (k * ny + j) * nx + i;
+  int sx = (nx > 1) ? 1 : 0, sy = (ny > 1) ? nx : 0, sz = (nz > 1) ? nx * ny : 0;
+  int corners[8] = {g, g + sx, g + sy, g + sx + sy,
+                    g + sz, g + sx + sz, g + sy + sz, g + sx + sy + sz};
+  double weights[8] = {(1 - tx) * (1 - ty) * (1 - tz), tx * (1 - ty) * (1 - tz),
+                       (1 - tx) * ty * (1 - tz), tx * ty * (1 - tz),
+                       (1 - tx) * (1 - ty) * tz, tx * (1 - ty) * tz,
+                       (1 - tx) * ty * tz, tx * ty * tz};
+
+  Vector3D v;
+  for (int c = 0; c < 8; c++) {
+    v.x += weights[c] * grid_x[corners[c]];
+    v.y += weights[c] * grid_y[corners[c]];
+    v.z += weights[c] * grid_z[corners[c]];
+  }
+  return v;
+}
+
+void ForceFields::apply(Hair *hair, double mass) {
+  // Wind is the same everywhere, so sum it once
+  Vector3D wind;
+  for (ForceField &f : fields) {
+    if (f.type == WIND) wind += f.strength * f.direction.unit();
+  }
+
+  for (PointMass &pm : hair->point_masses) {
+    Vector3D accel = wind;
+
+    for (ForceField &f : fields) {
+      if (f.type != VORTEX) continue;
+      Vector3D axis = f.direction.unit();
+      Vector3D r = pm.position - f.center;
+      Vector3D r_perp = r - dot(r, axis) * axis;
+      double d = r_perp.norm();
+      if (d > 1e-9) {
+        accel += (f.strength * exp(-d / f.radius) / d) * cross(axis, r_perp);
+      }
+    }
+
+    if (has_turbulence && built) {
+      accel += turbulence(pm.position);
+    }
+
+    pm.forces += mass * accel;
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef CLOTHSIM_FORCEFIELD_H
+#define CLOTHSIM_FORCEFIELD_H
+
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "hair.h"
+#include "HairVector.h"
+
+using namespace CGL;
+using namespace std;
+
+enum e_force_field { WIND = 0, VORTEX = 1, TURBULENCE = 2 };
+
+struct ForceField {
+  ForceField() {}
+  ForceField(e_force_field type, double strength)
+      : type(type), strength(strength) {}
+
+  e_force_field type;
+
+  // Wind blows along direction; a vortex spins around the axis through
+  // center along direction
+  Vector3D direction = Vector3D(1, 0, 0);
+  Vector3D center;
+  double strength = 0;
+
+  // Vortex falloff radius
+  double radius = 10.0;
+
+  // Turbulence feature size and drift speed of the noise
+  double frequency = 0.05;
+  double speed = 1.0;
+};
+
+/**
+ * Accelerations from wind, vortex and curl-noise turbulence fields. The
+ * turbulence is cached on a coarse grid around the hair, rebuilt every
+ * refresh_interval seconds of simulated time, and looked up trilinearly by
+ * the particles.
+ */
+class ForceFields {
+public:
+  // Rebuilds the turbulence grid if it is stale or no longer covers the hair.
+  void update(HairVector *hairs, double time);
+
+  // Adds the field forces to each point mass of the hair.
+  void apply(Hair *hair, double mass);
+
+  // Where and as of when the turbulence grid was last built, false if it
+  // was not. Restoring rebuilds the same grid, so a run resumed from a
+  // checkpoint refreshes it at the same times and places.
+  bool cacheState(double &refresh_time, Vector3D &min, double &cell_size, int *size);
+  void restoreCache(bool was_built, double refresh_time, const Vector3D &min, double cell_size,
+                    const int *size);
+
+  vector<ForceField> fields;
+
+  int grid_resolution = 16;
+  double refresh_interval = 1.0 / 24.0;
+
+private:
+  void buildGrid(HairVector *hairs, double time);
+  void fillGrid(double time);
+  Vector3D turbulence(const Vector3D &p);
+
+  bool has_turbulence = false;
+  double last_refresh = 0;
+  bool built = false;
+
+  // Cached turbulence, one array per coordinate
+  int nx = 0, ny = 0, nz = 0;
+  Vector3D grid_min;
+  Vector3D grid_max;
+  double cell = 1.0;
+  vector<double> grid_x;
+  vector<double> grid_y;
+  vector<double> grid_z;
+};
+
+#endif //CLOTHSIM_FORCEFIELD_H
@@ -0,0 +1,196 @@
+#include <string.h>
+
+#include <iostream>
+
+#include "frameCapture.h"
+
+#include <CGL/lodepng.h>
+
+#define TINYEXR_IMPLEMENTATION
+#include <CGL/tinyexr.h>
+
+FrameCapture::FrameCapture(int num_workers) {
+  for (int i = 0; i < num_workers; i++) {
+    workers.push_back(thread(&FrameCapture::work, this));
+  }
+}
+
+FrameCapture::~FrameCapture() {
+  finish();
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  job_ready.notify_all();
+  for (thread &worker : workers) {
+    worker.join();
+  }
+  for (Read &read : ring) {
+    if (read.pbo) glDeleteBuffers(1, &read.pbo);
+  }
+}
+
+void FrameCapture::capture(const string &filename, e_format format) {
+  if (in_flight == RING_SIZE) retireOldest(true);
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  int width = viewport[2], height = viewport[3];
+  size_t bytes = (size_t) width * height * (format == EXR ? 4 * sizeof(float) : 4);
+
+  Read &read = ring[head];
+  if (!read.pbo) glGenBuffers(1, &read.pbo);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, read.pbo);
+  if (bytes > read.capacity) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    read.capacity = bytes;
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(viewport[0], viewport[1], width, height, GL_RGBA,
+               format == EXR ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  read.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  read.filename = filename;
+  read.format = format;
+  read.width = width;
+  read.height = height;
+  head = (head + 1) % RING_SIZE;
+  in_flight++;
+}
+
+void FrameCapture::poll() {
+  while (in_flight > 0) {
+    Read &oldest = ring[(head - in_flight + RING_SIZE) % RING_SIZE];
+    GLenum state = glClientWaitSync(oldest.fence, 0, 0);
+    if (state == GL_TIMEOUT_EXPIRED) break;
+    retireOldest(false);
+  }
+}
+
+void FrameCapture::finish() {
+  while (in_flight > 0) {
+    retireOldest(true);
+  }
+  unique_lock<mutex> guard(lock);
+  job_done.wait(guard, [this] { return jobs.empty() && busy == 0; });
+}
+
+void FrameCapture::retireOldest(bool wait) {
+  Read &read = ring[(head - in_flight + RING_SIZE) % RING_SIZE];
+  in_flight--;
+
+  if (wait) {
+    // Flush so the fence gets submitted, then block a second at a time
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(read.fence, flags, 1000000000) == GL_TIMEOUT_EXPIRED) {
+      flags = 0;
+    }
+  }
+  glDeleteSync(read.fence);
+  read.fence = nullptr;
+
+  Job job;
+  job.filename = read.filename;
+  job.format = read.format;
+  job.width = read.width;
+  job.height = read.height;
+  size_t bytes = (size_t) read.width * read.height * (read.format == EXR ? 4 * sizeof(float) : 4);
+  job.pixels.resize(bytes);
+
+  // The copy keeps the buffer free for the next read while the workers
+  // take their time
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, read.pbo);
+  void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+  if (data) {
+    memcpy(job.pixels.data(), data, bytes);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (!data) {
+    cout << "Could not read back " << job.filename << endl;
+    return;
+  }
+
+  {
+    unique_lock<mutex> guard(lock);
+    job_done.wait(guard, [this] { return jobs.size() < MAX_QUEUED; });
+    jobs.push_back(move(job));
+  }
+  job_ready.notify_one();
+}
+
+void FrameCapture::work() {
+  while (true) {
+    Job job;
+    {
+      unique_lock<mutex> guard(lock);
+      job_ready.wait(guard, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty()) return;
+      job = move(jobs.front());
+      jobs.pop_front();
+      busy++;
+    }
+    job_done.notify_all();
+
+    encode(job);
+
+    {
+      lock_guard<mutex> guard(lock);
+      busy--;
+    }
+    job_done.notify_all();
+  }
+}
+
+// OpenGL returns the rows bottom up, both formats want them top down
+void FrameCapture::encode(Job &job) {
+  int w = job.width, h = job.height;
+
+  if (job.format == PNG) {
+    vector<unsigned char> image(job.pixels.size());
+    for (int y = 0; y < h; y++) {
+      memcpy(&image[(size_t) y * w * 4], &job.pixels[(size_t) (h - 1 - y) * w * 4], w * 4);
+    }
+    unsigned error = lodepng::encode(job.filename, image, w, h);
+    if (error) {
+      cout << "Could not write " << job.filename << ": " << lodepng_error_text(error) << endl;
+    }
+    return;
+  }
+
+  // Planar channels in the alphabetical order EXR readers expect, stored as
+  // half floats
+  const float *rgba = reinterpret_cast<const float *>(job.pixels.data());
+  vector<float> b((size_t) w * h), g((size_t) w * h), r((size_t) w * h);
+  for (int y = 0; y < h; y++) {
+    const float *row = rgba + (size_t) (h - 1 - y) * w * 4;
+    for (int x = 0; x < w; x++) {
+      size_t i = (size_t) y * w + x;
+      r[i] = row[4 * x];
+      g[i] = row[4 * x + 1];
+      b[i] = row[4 * x + 2];
+    }
+  }
+
+  const char *channel_names[] = {"B", "G", "R"};
+  float *images[] = {b.data(), g.data(), r.data()};
+  int pixel_types[] = {TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT};
+  int requested_pixel_types[] = {TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF,
+                                 TINYEXR_PIXELTYPE_HALF};
+
+  EXRImage image;
+  InitEXRImage(&image);
+  image.num_channels = 3;
+  image.channel_names = channel_names;
+  image.images = reinterpret_cast<unsigned char **>(images);
+  image.pixel_types = pixel_types;
+  image.requested_pixel_types = requested_pixel_types;
+  image.width = w;
+  image.height = h;
+
+  const char *err = nullptr;
+  if (SaveMultiChannelEXRToFile(&image, job.filename.c_str(), &err) != 0) {
+    cout << "Could not write " << job.filename << ": " << (err ? err : "unknown error") << endl;
+  }
+}
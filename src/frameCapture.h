@@ -0,0 +1,81 @@
+#ifndef CLOTHSIM_FRAMECAPTURE_H
+#define CLOTHSIM_FRAMECAPTURE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+using namespace std;
+
+/**
+ * Writes the viewport to image files without stalling the render loop.
+ *
+ * capture() starts a glReadPixels into one of a ring of pixel buffer
+ * objects and returns right away. A frame or two later, once the fence
+ * behind the read has passed, poll() maps the buffer, copies the pixels out
+ * and hands them to a pool of worker threads, which flip and encode them as
+ * PNG (lodepng) or EXR (tinyexr). The render thread only waits when every
+ * buffer of the ring is still in flight or the encoders are MAX_QUEUED
+ * frames behind, so long recordings slow down instead of dropping frames.
+ *
+ * Everything except encoding runs on the thread that owns the GL context.
+ */
+class FrameCapture {
+public:
+  enum e_format { PNG = 0, EXR = 1 };
+
+  FrameCapture(int num_workers = 2);
+  ~FrameCapture();
+
+  // Reads the current viewport of the bound read framebuffer into filename
+  void capture(const string &filename, e_format format);
+
+  // Queues the reads that have finished for encoding, once per frame
+  void poll();
+
+  // Waits for every pending read and encode
+  void finish();
+
+private:
+  struct Read {
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    size_t capacity = 0; // bytes
+    string filename;
+    e_format format;
+    int width, height;
+  };
+
+  struct Job {
+    string filename;
+    e_format format;
+    int width, height;
+    vector<unsigned char> pixels;
+  };
+
+  static const int RING_SIZE = 3;
+  static const int MAX_QUEUED = 8;
+
+  void retireOldest(bool wait);
+  void work();
+  static void encode(Job &job);
+
+  Read ring[RING_SIZE];
+  int head = 0;      // next buffer to read into
+  int in_flight = 0; // reads behind head whose pixels are not queued yet
+
+  vector<thread> workers;
+  deque<Job> jobs;
+  int busy = 0;
+  bool stopping = false;
+  mutex lock;
+  condition_variable job_ready;
+  condition_variable job_done;
+};
+
+#endif //CLOTHSIM_FRAMECAPTURE_H
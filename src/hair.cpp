@@ -21,10 +21,6 @@ void Hair::externalForces(double frames_per_sec, double simulation_steps, vector
   for (int accel = 0; accel < external_accelerations.size(); accel++) {
     totalExtAccel += external_accelerations[accel];
   }
-
-  for (int accel = 1; accel < external_accelerations.size(); accel++) {
-    totalExtAccel += external_accelerations[accel];
-  }
   totalExtAccel *= mass;
 
   for (PointMass &pm : point_masses) {
@@ -33,69 +29,126 @@ void Hair::externalForces(double frames_per_sec, double simulation_steps, vector
   }
 }
 
-void Hair::stretchSpring(double frames_per_sec, double simulation_steps, double ks, double cs, double ab) {
+void Hair::springForces(double frames_per_sec, double simulation_steps, bool stretch, bool support,
+                        double ks, double cs, double kb, double cb, double drag, double ab) {
   positionSmoothingFunction(ab); // to show smoothed curve
 
+  int n = point_masses.size();
+  if (n < 2) return;
+
   double delta_t = 1.0f / frames_per_sec / simulation_steps;
-  for (Spring &s : springs) {
-    double current_length = (s.pm_a->position - s.pm_b->position).norm();
-//    Vector3D forceApplied = (ks * (current_length - s.rest_length) * unit_dir) +
-//                            (cs * dot(delta_v, unit_dir) * unit_dir);
-    Vector3D forceApplied = ks * (current_length - s.rest_length);
-    s.pm_a->forces += forceApplied * (s.pm_b->position - s.pm_a->position).unit();
-    s.pm_b->forces += forceApplied * (s.pm_a->position - s.pm_b->position).unit();
+
+  // One sweep down the strand with a window over particles i, i+1 and i+2:
+  // each position and velocity is read once, the stretch spring (i, i+1),
+  // the support spring (i, i+2) and the air drag on segment (i, i+1) all use
+  // the same loads.
+  Vector3D x0 = point_masses[0].position, v0 = point_masses[0].velocity(delta_t);
+  Vector3D x1 = point_masses[1].position, v1 = point_masses[1].velocity(delta_t);
+
+  for (int i = 0; i < n - 1; i++) {
+    PointMass &pm0 = point_masses[i];
+    PointMass &pm1 = point_masses[i+1];
+
+    Vector3D x2, v2;
+    if (i + 2 < n) {
+      x2 = point_masses[i+2].position;
+      v2 = point_masses[i+2].velocity(delta_t);
+    }
+
+    Vector3D edge = x1 - x0;
+    double current_length = edge.norm();
+    Vector3D unit_dir = edge / current_length;
+    Vector3D delta_v = v1 - v0;
+
+    if (stretch) {
+      double forceApplied = ks * (current_length - springs[i].rest_length) +
+                            cs * dot(delta_v, unit_dir);
+      pm0.forces += forceApplied * unit_dir;
+      pm1.forces -= forceApplied * unit_dir;
+    }
+
+    // Drag on the velocity normal to the segment, proportional to its length
+    Vector3D v_seg = 0.5 * (v0 + v1);
+    Vector3D v_normal = v_seg - dot(v_seg, unit_dir) * unit_dir;
+    Vector3D drag_force = (-0.5 * drag * current_length) * v_normal;
+    pm0.forces += drag_force;
+    pm1.forces += drag_force;
+
+    if (support && i + 2 < n) {
+      Vector3D support_edge = x2 - x0;
+      double support_length = support_edge.norm();
+      Vector3D support_dir = support_edge / support_length;
+      double forceApplied = kb * (support_length - support_springs[i].rest_length) +
+                            cb * dot(v2 - v0, support_dir);
+      pm0.forces += forceApplied * support_dir;
+      point_masses[i+2].forces -= forceApplied * support_dir;
+    }
+
+    x0 = x1; v0 = v1;
+    x1 = x2; v1 = v2;
   }
 }
 
-void Hair::supportSpring(double frames_per_sec, double simulation_steps, double kb, double cb, double ab) { 
-
-  positionSmoothingFunction(ab);   // to show smoothed curve
-
-  double delta_t = 1.0f / frames_per_sec / simulation_steps; 
-  for (Spring &s : support_springs) { 
-    double current_length = (s.pm_a->position - s.pm_b->position).norm();
-    Vector3D delta_v = s.pm_b->velocity(delta_t) - s.pm_a->velocity(delta_t); 
-    Vector3D unit_dir = (s.pm_b->position - s.pm_a->position).unit(); 
-//    Vector3D forceApplied = (kb * (current_length - s.rest_length) * unit_dir) +
-//                            (cb * dot(delta_v, unit_dir) * unit_dir); 
-     Vector3D forceApplied = kb * (current_length - s.rest_length);
-     s.pm_a->forces += forceApplied * (s.pm_b->position - s.pm_a->position).unit(); 
-     s.pm_b->forces += forceApplied * (s.pm_a->position - s.pm_b->position).unit(); 
-   } 
+void Hair::buildBendFrames() {
+  int n = point_masses.size();
+  if (n < 2) return;
+
+  // Any normal works for the root frame, pick it away from the tangent
+  Vector3D t = (point_masses[1].start_position - point_masses[0].start_position).unit();
+  Vector3D axis = fabs(t.x) < 0.9 ? Vector3D(1, 0, 0) : Vector3D(0, 1, 0);
+  Vector3D u = cross(t, axis).unit();
+  rest_root_tangent = t;
+  rest_root_normal = u;
+
+  // Express every rest edge in the frame transported along the edges before it
+  for (int i = 1; i < n - 1; i++) {
+    Vector3D edge = point_masses[i+1].start_position - point_masses[i].start_position;
+    Vector3D v = cross(t, u);
+    point_masses[i].ref_vector = Vector3D(dot(edge, t), dot(edge, u), dot(edge, v));
+
+    Vector3D t_next = edge.unit();
+    u = parallelTransport(u, t, t_next).unit();
+    t = t_next;
+  }
 }
 
-void Hair::bendSpring(double frames_per_sec, double simulation_steps, double kb, double cb, double ab) {
-//  positionSmoothingFunction(ab);
-//  double delta_t = 1.0f / frames_per_sec / simulation_steps;
-//
-//  for (int i = 1; i < point_masses.size() - 1; i++) {
-//    PointMass* pm = &point_masses[i];
-//    PointMass* pm_before = &point_masses[i-1];
-//    PointMass* pm_after = &point_masses[i+1];
-//
-//    Vector3D frame_1 =  (pm->smoothed_position - pm_before->smoothed_position).unit();
-//    Vector3D frame_2 = cross(frame_1, Vector3D(0, 0, 1)).unit();
-//
-//    double frame_coord[] = {
-//            frame_1.x, frame_2.x, 0.0,
-//            frame_1.y, frame_2.y, 0.0,
-//            frame_1.z, frame_2.z, 1.0
-//    };
-//
-//    Matrix3x3 ref_frame = Matrix3x3(frame_coord);
-//
-//    Vector3D target_vector = (ref_frame * pm->ref_vector);
-//    Vector3D target_pos = pm->position + target_vector;
-//    Vector3D delta_v = pm_after->velocity(delta_t) - pm->velocity(delta_t);
-//
-//    Vector3D edge = pm_after->start_position - pm->start_position;
-//    Vector3D forceApplied = (kb * (edge - target_vector)) +
-//                            cb * (delta_v - (dot(delta_v, edge.unit())) * edge.unit());
-//
-//    pm->forces += -forceApplied;
-//    pm_after->forces += forceApplied;
-//    pm_after->bend_target_pos = target_pos;
-//  }
+void Hair::bendSpring(double frames_per_sec, double simulation_steps, double kb, double cb) {
+  int n = point_masses.size();
+  if (n < 3) return;
+
+  double delta_t = 1.0f / frames_per_sec / simulation_steps;
+
+  // Carry the root frame onto the current first edge, then transport it one
+  // edge at a time while pulling each edge towards its rest coordinates in
+  // the frame of the edge before it.
+  Vector3D t = (point_masses[1].position - point_masses[0].position).unit();
+  Vector3D u = parallelTransport(rest_root_normal, rest_root_tangent, t);
+
+  for (int i = 1; i < n - 1; i++) {
+    PointMass &pm = point_masses[i];
+    PointMass &pm_after = point_masses[i+1];
+
+    Vector3D v = cross(t, u);
+    Vector3D target = pm.ref_vector.x * t + pm.ref_vector.y * u + pm.ref_vector.z * v;
+    Vector3D edge = pm_after.position - pm.position;
+    Vector3D edge_dir = edge.unit();
+
+    // Damp the relative velocity across the edge only, stretching is damped
+    // by the stretch springs
+    Vector3D delta_v = pm_after.velocity(delta_t) - pm.velocity(delta_t);
+    Vector3D forceApplied = kb * (edge - target) +
+                            cb * (delta_v - dot(delta_v, edge_dir) * edge_dir);
+
+    pm.forces += forceApplied;
+    pm_after.forces -= forceApplied;
+
+    pm_after.bend_target_pos = pm.position + target;
+    pm.frame_1 = pm.position + u * (0.5 * avg_spring_length);
+    pm.frame_2 = pm.position + v * (0.5 * avg_spring_length);
+
+    u = parallelTransport(u, t, edge_dir).unit();
+    t = edge_dir;
+  }
 }
 
 void Hair::coreSpring(double frames_per_sec, double simulation_steps, double kc, double cc, double ac) {
@@ -108,10 +161,9 @@ void Hair::coreSpring(double frames_per_sec, double simulation_steps, double kc,
     Vector3D smooth_rest_edge = pm_after->rest_core_smoothed_position - pm->rest_core_smoothed_position;    // rest bi
     Vector3D smooth_curr_edge = pm_after->smoothed_position - pm->smoothed_position;    // bi
 
-//    Vector3D forceApplied = (kc * (smooth_curr_edge.norm() - smooth_rest_edge.norm()) * smooth_curr_edge.unit()) +
-//                            (cc * dot(pm->smoothed_velocity, smooth_curr_edge.unit()) * smooth_curr_edge.unit());
-
-    Vector3D forceApplied = kc * (smooth_curr_edge.norm() - smooth_rest_edge.norm());
+    Vector3D smooth_delta_v = pm_after->smoothed_velocity - pm->smoothed_velocity;
+    double forceApplied = kc * (smooth_curr_edge.norm() - smooth_rest_edge.norm()) +
+                          cc * dot(smooth_delta_v, smooth_curr_edge.unit());
 
     pm->forces += forceApplied * -smooth_curr_edge.unit();
     pm_after->forces += forceApplied * smooth_curr_edge.unit();
@@ -268,7 +320,8 @@ void Hair::velocitySmoothingFunction(double frames_per_sec, double simulation_st
   }
 }
 
-void Hair::updatePositions(double frames_per_sec, double simulation_steps, double density, double damping) {
+void Hair::updatePositions(double frames_per_sec, double simulation_steps, double density, double damping,
+                           int projection_levels, bool tethers) {
   double mass = length * density / (double) particles_count;
   double delta_t = 1.0f / frames_per_sec / simulation_steps;
 
@@ -280,6 +333,10 @@ void Hair::updatePositions(double frames_per_sec, double simulation_steps, doubl
     }
   }
 
+  if (projection_levels > 0) {
+    coarseStrainLimit(projection_levels);
+  }
+
   for (Spring &s : springs) {
     if (s.pm_a->pinned && !s.pm_b->pinned) {   // a pinned, b loose
       double springLength = (s.pm_a->position - s.pm_b->position).norm();
@@ -313,5 +370,205 @@ void Hair::updatePositions(double frames_per_sec, double simulation_steps, doubl
       }
     }
   }
+
+  if (tethers) {
+    tetherConstraints();
+  }
+}
+
+void Hair::coarseStrainLimit(int levels) {
+  // The fine clamping below moves a correction one segment per substep, so a
+  // long strand stays overstretched for many substeps. First clamp the length
+  // of runs of 2^l segments, coarsest level first, by scaling the whole run
+  // about its center so its shape is kept. A run can only be longer than 1.1
+  // times its rest length if one of its segments is, so this never clamps
+  // anything the fine pass would not.
+  int n = point_masses.size();
+  segment_lengths.resize(n - 1);
+  for (int i = 0; i < n - 1; i++) {
+    segment_lengths[i] = (point_masses[i + 1].position - point_masses[i].position).norm();
+  }
+
+  for (int level = levels; level > 0; level--) {
+    int stride = 1 << level;
+    if (stride >= n - 1) continue;
+
+    for (int a = 0; a < n - 1; a += stride) {
+      int b = min(a + stride, n - 1);
+
+      double current = 0, rest = 0;
+      for (int i = a; i < b; i++) {
+        current += segment_lengths[i];
+        rest += springs[i].rest_length;
+      }
+      if (current <= rest * 1.1) continue;
+
+      Vector3D center = point_masses[a].position;
+      if (!point_masses[a].pinned) {
+        center = Vector3D();
+        for (int i = a; i <= b; i++) {
+          center += point_masses[i].position;
+        }
+        center /= (double) (b - a + 1);
+      }
+
+      double scale = rest * 1.1 / current;
+      for (int i = a; i <= b; i++) {
+        PointMass &pm = point_masses[i];
+        if (!pm.pinned) pm.position = center + (pm.position - center) * scale;
+      }
+      for (int i = max(a - 1, 0); i < min(b + 1, n - 1); i++) {
+        segment_lengths[i] = (point_masses[i + 1].position - point_masses[i].position).norm();
+      }
+    }
+  }
+}
+
+void Hair::tetherConstraints() {
+  // Long range attachments: no particle may be further from the pinned root
+  // than its rest length along the strand. Each tether only involves the root,
+  // so one pass enforces all of them however long the strand is. They run
+  // last and can break the 1.1 bound of the segment clamps: a particle pulled
+  // towards the root while its child is not stretches the segment between
+  // them. The per segment pass of the next substep clamps it again.
+  PointMass &root = point_masses[0];
+  if (!root.pinned) return;
+
+  for (int i = 1; i < point_masses.size(); i++) {
+    PointMass &pm = point_masses[i];
+    if (pm.pinned) continue;
+    Vector3D offset = pm.position - root.position;
+    double distance = offset.norm();
+    if (distance > tether_lengths[i]) {
+      pm.position = root.position + offset * (tether_lengths[i] / distance);
+    }
+  }
+}
+
+void Hair::stepMetrics(double delta_t, double &max_speed, double &max_strain) {
+  max_speed = 0;
+  max_strain = 0;
+
+  for (PointMass &pm : point_masses) {
+    max_speed = max(max_speed, pm.velocity(delta_t).norm());
+  }
+
+  // Strain change over the substep, the stretch springs sit at the 10% clamp
+  // regardless of the step size
+  for (Spring &s : springs) {
+    double springLength = (s.pm_a->position - s.pm_b->position).norm();
+    double lastLength = (s.pm_a->last_position - s.pm_b->last_position).norm();
+    max_strain = max(max_strain, fabs(springLength - lastLength) / s.rest_length);
+  }
+}
+
+void Hair::rescaleVelocities(double ratio) {
+  // Verlet stores velocity implicitly as position - last_position, so a change
+  // of time step has to rescale that difference to keep the velocity intact.
+  for (PointMass &pm : point_masses) {
+    if (!pm.pinned) {
+      pm.last_position = pm.position - (pm.position - pm.last_position) * ratio;
+    }
+  }
+}
+
+double Hair::kineticEnergy(double delta_t) {
+  // Kinetic energy per unit mass, so the sleep threshold does not depend on
+  // the density or particle count
+  double energy = 0;
+  for (PointMass &pm : point_masses) {
+    energy += 0.5 * pm.velocity(delta_t).norm2();
+  }
+  return energy / point_masses.size();
+}
+
+void Hair::sleep() {
+  asleep = true;
+  for (PointMass &pm : point_masses) {
+    pm.last_position = pm.position;
+  }
 }
 
+void Hair::wake() {
+  asleep = false;
+  still_steps = 0;
+}
+
+void Hair::buildSprings() {
+  springs.clear();
+  support_springs.clear();
+
+  // create stretch springs
+  for (int i = 0; i < (int) point_masses.size() - 1; i++) {
+    PointMass* pm1 = &point_masses[i];
+    PointMass* pm2 = &point_masses[i+1];
+    double spring_length = (pm2->start_position - pm1->start_position).norm();
+    springs.push_back(Spring(pm1, pm2, spring_length));
+  }
+
+  // create support springs
+  for (int i = 0; i < (int) point_masses.size() - 2; i++) {
+    PointMass* pm1 = &point_masses[i];
+    PointMass* pm2 = &point_masses[i+2];
+    double spring_length = (pm2->start_position - pm1->start_position).norm();
+    support_springs.push_back(Spring(pm1, pm2, spring_length));
+  }
+
+  tether_lengths.assign(1, 0.0);
+  for (Spring &s : springs) {
+    tether_lengths.push_back(tether_lengths.back() + s.rest_length);
+  }
+  buildBendFrames();
+}
+
+// Finds the segment k and the fraction t within it at arc length s.
+static void locateArcLength(const vector<double> &arc, double s, int &k, double &t) {
+  k = 0;
+  while (k < (int) arc.size() - 2 && arc[k+1] < s) {
+    k++;
+  }
+  double segment = arc[k+1] - arc[k];
+  t = segment > 0 ? min(1.0, max(0.0, (s - arc[k]) / segment)) : 0.0;
+}
+
+void Hair::resample(int new_count) {
+  if (new_count == point_masses.size()) return;
+
+  vector<double> arc(point_masses.size(), 0.0);
+  for (int i = 1; i < point_masses.size(); i++) {
+    arc[i] = arc[i-1] + (point_masses[i].position - point_masses[i-1].position).norm();
+  }
+
+  vector<double> rest_arc(full_start_positions.size(), 0.0);
+  for (int i = 1; i < full_start_positions.size(); i++) {
+    rest_arc[i] = rest_arc[i-1] + (full_start_positions[i] - full_start_positions[i-1]).norm();
+  }
+
+  // Sample the current and rest shapes at the same fractions of their arc
+  // lengths. Position and last position share the weights, so the Verlet
+  // velocity is interpolated along with them.
+  vector<PointMass> resampled;
+  resampled.reserve(new_count);
+  for (int j = 0; j < new_count; j++) {
+    double u = (double) j / (new_count - 1);
+    int k;
+    double t;
+
+    locateArcLength(rest_arc, u * rest_arc.back(), k, t);
+    Vector3D start = (1.0 - t) * full_start_positions[k] + t * full_start_positions[k+1];
+    PointMass pm(start, j == 0);
+
+    locateArcLength(arc, u * arc.back(), k, t);
+    PointMass &a = point_masses[k];
+    PointMass &b = point_masses[k+1];
+    pm.position = (1.0 - t) * a.position + t * b.position;
+    pm.last_position = (1.0 - t) * a.last_position + t * b.last_position;
+    resampled.push_back(pm);
+  }
+
+  point_masses = resampled;
+  particles_count = new_count;
+  wake();
+  avg_spring_length = length / (particles_count - 1);
+  buildSprings();
+}
@@ -6,12 +6,22 @@
 #include <vector>
 
 #include "CGL/CGL.h"
+#include "CGL/matrix3x3.h"
 #include "CGL/misc.h"
 #include "spring.h"
 
 using namespace CGL;
 using namespace std;
 
+// Rotates u by the rotation taking unit vector a onto unit vector b about
+// their common normal, i.e. parallel transports u from a to b.
+inline Vector3D parallelTransport(const Vector3D &u, const Vector3D &a, const Vector3D &b) {
+  Vector3D c = cross(a, b);
+  double d = dot(a, b);
+  if (d < -1.0 + 1e-9) return -u;
+  return u * d + cross(c, u) + c * (dot(c, u) / (1.0 + d));
+}
+
 struct Hair {
 Hair() {}
 Hair(int particles_count, double length)
@@ -19,15 +29,26 @@ Hair(int particles_count, double length)
 ~Hair();
 
 void externalForces(double frames_per_sec, double simulation_steps, vector<Vector3D> external_accelerations, double density);
-void stretchSpring(double frames_per_sec, double simulation_steps, double ks, double cs, double ab);
-void supportSpring(double frames_per_sec, double simulation_steps, double kb, double cb, double bend_constant);
-void bendSpring(double frames_per_sec, double simulation_steps, double kb, double cb, double bend_constant);
+void springForces(double frames_per_sec, double simulation_steps, bool stretch, bool support,
+                  double ks, double cs, double kb, double cb, double drag, double ab);
+void bendSpring(double frames_per_sec, double simulation_steps, double kb, double cb);
 void coreSpring(double frames_per_sec, double simulation_steps, double kc, double cc, double bend_constant);
 void restBendSmoothingFunction(double ab);
 void restCoreSmoothingFunction(double ac);
 void positionSmoothingFunction(double bend_constant);
 void velocitySmoothingFunction(double frames_per_sec, double simulation_steps, double ac);
-void updatePositions(double frames_per_sec, double simulation_steps, double density, double damping);
+void updatePositions(double frames_per_sec, double simulation_steps, double density, double damping,
+                     int projection_levels, bool tethers);
+void coarseStrainLimit(int levels);
+void tetherConstraints();
+void stepMetrics(double delta_t, double &max_speed, double &max_strain);
+void rescaleVelocities(double ratio);
+void buildSprings();
+void buildBendFrames();
+double kineticEnergy(double delta_t);
+void sleep();
+void wake();
+void resample(int new_count);
 
 int particles_count;
 double length;
@@ -35,6 +56,27 @@ double avg_spring_length;
 vector<Spring> springs;
 vector<Spring> support_springs;
 vector<PointMass> point_masses;
+
+// rest length along the strand from the root to each particle
+vector<double> tether_lengths;
+
+// scratch for coarseStrainLimit, the current length of each segment
+vector<double> segment_lengths;
+
+// rest frame of the first edge, the bending frames are transported from it
+Vector3D rest_root_tangent;
+Vector3D rest_root_normal;
+
+// rotation of the root from its rest pose, set by the root animation
+Matrix3x3 root_rotation = Matrix3x3::identity();
+
+// sleeping
+bool asleep = false;
+int still_steps = 0;
+
+// level of detail
+int lod_level = 0;
+vector<Vector3D> full_start_positions;
 };
 
 #endif //CLOTHSIM_HAIR_H
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "hairGrid.h"
+#include "HairVector.h"
+
+using namespace std;
+
+void HairGrid::build(HairVector *hairs, double delta_t) {
+  vector<Hair *> &strands = *hairs->hair_vector;
+
+  Vector3D lo(INF_D), hi(-INF_D);
+  double spring_length = 0;
+  for (Hair *hair : strands) {
+    for (PointMass &pm : hair->point_masses) {
+      const Vector3D &p = pm.position;
+      lo = Vector3D(min(lo.x, p.x), min(lo.y, p.y), min(lo.z, p.z));
+      hi = Vector3D(max(hi.x, p.x), max(hi.y, p.y), max(hi.z, p.z));
+    }
+    spring_length += hair->avg_spring_length;
+  }
+  if (strands.empty()) return;
+
+  Vector3D extent = hi - lo;
+  double largest = max(max(extent.x, extent.y), extent.z);
+  cell = cell_size > 0 ? cell_size : spring_length / strands.size();
+  cell = max(cell, largest / (max_cells - 3));
+
+  // One empty layer of cells around the hair so samples near the boundary
+  // see the density fall off
+  grid_min = lo - Vector3D(cell);
+  nx = (int) ceil(extent.x / cell) + 3;
+  ny = (int) ceil(extent.y / cell) + 3;
+  nz = (int) ceil(extent.z / cell) + 3;
+
+  int num_nodes = nx * ny * nz;
+  rho.resize(num_nodes);
+  mom_x.resize(num_nodes);
+  mom_y.resize(num_nodes);
+  mom_z.resize(num_nodes);
+
+  // Each thread splats a fixed share of the strands into its own buffer,
+  // then each node sums the buffers in thread order, so the result does not
+  // depend on scheduling. The buffers are kept and left zeroed for the next
+  // build.
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  if (splats.size() < num_threads) splats.resize(num_threads);
+  for (vector<double> &splat : splats) {
+    if (splat.size() < 4 * num_nodes) splat.resize(4 * num_nodes, 0.0);
+  }
+
+  int num_strands = strands.size();
+#pragma omp parallel num_threads(num_threads)
+  {
+    int t = 0;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+    double *splat = splats[t].data();
+
+#pragma omp for schedule(static)
+    for (int s = 0; s < num_strands; s++) {
+      for (PointMass &pm : strands[s]->point_masses) {
+        int nodes[8];
+        double w[8];
+        weights(pm.position, nodes, w);
+        Vector3D v = pm.velocity(delta_t);
+        for (int c = 0; c < 8; c++) {
+          double *node = splat + 4 * nodes[c];
+          node[0] += w[c];
+          node[1] += w[c] * v.x;
+          node[2] += w[c] * v.y;
+          node[3] += w[c] * v.z;
+        }
+      }
+    }
+
+#pragma omp for schedule(static)
+    for (int g = 0; g < num_nodes; g++) {
+      double r = 0, x = 0, y = 0, z = 0;
+      for (int u = 0; u < num_threads; u++) {
+        double *node = &splats[u][4 * g];
+        r += node[0];
+        x += node[1];
+        y += node[2];
+        z += node[3];
+        node[0] = node[1] = node[2] = node[3] = 0;
+      }
+      rho[g] = r;
+      mom_x[g] = x;
+      mom_y[g] = y;
+      mom_z[g] = z;
+    }
+  }
+}
+
+void HairGrid::weights(const Vector3D &p, int *nodes, double *w) {
+  double fx = min(max((p.x - grid_min.x) / cell, 0.0), nx - 1.000001);
+  double fy = min(max((p.y - grid_min.y) / cell, 0.0), ny - 1.000001);
+  double fz = min(max((p.z - grid_min.z) / cell, 0.0), nz - 1.000001);
+  int i = (int) fx, j = (int) fy, k = (int) fz;
+  double tx = fx - i, ty = fy - j, tz = fz - k;
+
+  int g = (k * ny + j) * nx + i;
+  int sy = nx, sz = nx * ny;
+  nodes[0] = g;           w[0] = (1 - tx) * (1 - ty) * (1 - tz);
+  nodes[1] = g + 1;       w[1] = tx * (1 - ty) * (1 - tz);
+  nodes[2] = g + sy;      w[2] = (1 - tx) * ty * (1 - tz);
+  nodes[3] = g + 1 + sy;  w[3] = tx * ty * (1 - tz);
+  nodes[4] = g + sz;      w[4] = (1 - tx) * (1 - ty) * tz;
+  nodes[5] = g + 1 + sz;  w[5] = tx * (1 - ty) * tz;
+  nodes[6] = g + sy + sz; w[6] = (1 - tx) * ty * tz;
+  nodes[7] = g + 1 + sy + sz; w[7] = tx * ty * tz;
+}
+
+double HairGrid::density(const Vector3D &p) {
+  if (rho.empty()) return 0;
+
+  int nodes[8];
+  double w[8];
+  weights(p, nodes, w);
+
+  double d = 0;
+  for (int c = 0; c < 8; c++) {
+    d += w[c] * rho[nodes[c]];
+  }
+  return d;
+}
+
+Vector3D HairGrid::velocity(const Vector3D &p) {
+  if (rho.empty()) return Vector3D();
+
+  int nodes[8];
+  double w[8];
+  weights(p, nodes, w);
+
+  double d = 0;
+  Vector3D momentum;
+  for (int c = 0; c < 8; c++) {
+    d += w[c] * rho[nodes[c]];
+    momentum += w[c] * Vector3D(mom_x[nodes[c]], mom_y[nodes[c]], mom_z[nodes[c]]);
+  }
+  return d > 1e-12 ? momentum / d : Vector3D();
+}
+
+void HairGrid::smoothVelocities(Hair *hair, double delta_t) {
+  if (smoothing <= 0) return;
+
+  for (PointMass &pm : hair->point_masses) {
+    if (pm.pinned) continue;
+    Vector3D v = pm.velocity(delta_t);
+    v += smoothing * (velocity(pm.position) - v);
+    pm.last_position = pm.position - v * delta_t;
+  }
+}
+
+void HairGrid::applyRepulsion(Hair *hair, double mass) {
+  if (repulsion <= 0) return;
+
+  double h = 0.5 * cell;
+  for (PointMass &pm : hair->point_masses) {
+    const Vector3D &p = pm.position;
+    double excess = density(p) - target_density;
+    if (excess <= 0) continue;
+
+    Vector3D grad((density(p + Vector3D(h, 0, 0)) - density(p - Vector3D(h, 0, 0))) / cell,
+                  (density(p + Vector3D(0, h, 0)) - density(p - Vector3D(0, h, 0))) / cell,
+                  (density(p + Vector3D(0, 0, h)) - density(p - Vector3D(0, 0, h))) / cell);
+    double norm = grad.norm();
+    if (norm > 1e-12) {
+      pm.forces += (-repulsion * mass * excess / norm) * grad;
+    }
+  }
+}
+
+double HairGrid::transmittance(const Vector3D &p) {
+  if (rho.empty()) return 1.0;
+
+  Vector3D step = light_direction.unit() * cell;
+  Vector3D grid_max = grid_min + Vector3D(nx - 1, ny - 1, nz - 1) * cell;
+
+  // Start one cell out so a particle does not shadow itself
+  double optical_depth = 0;
+  for (Vector3D q = p + step;
+       q.x >= grid_min.x && q.y >= grid_min.y && q.z >= grid_min.z &&
+       q.x <= grid_max.x && q.y <= grid_max.y && q.z <= grid_max.z;
+       q += step) {
+    optical_depth += density(q);
+  }
+  return exp(-opacity * optical_depth);
+}
@@ -0,0 +1,65 @@
+#ifndef CLOTHSIM_HAIRGRID_H
+#define CLOTHSIM_HAIRGRID_H
+
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "hair.h"
+
+using namespace CGL;
+using namespace std;
+
+struct HairVector;
+
+/**
+ * Density and velocity of the whole groom on a regular grid, splatted from
+ * every particle with trilinear weights. Hair-hair interaction then goes
+ * through the grid instead of particle pairs:
+ *
+ *  - repulsion pushes particles down the density gradient where the hair
+ *    is denser than target_density, which keeps the volume of the groom;
+ *  - velocity smoothing blends each particle velocity towards the grid
+ *    velocity (Petrovic et al. 2005, McAdams et al. 2009);
+ *  - transmittance marches the density towards the light for deep opacity
+ *    shadows.
+ */
+class HairGrid {
+public:
+  void build(HairVector *hairs, double delta_t);
+
+  void smoothVelocities(Hair *hair, double delta_t);
+  void applyRepulsion(Hair *hair, double mass);
+
+  double density(const Vector3D &p);
+  Vector3D velocity(const Vector3D &p);
+  double transmittance(const Vector3D &p);
+
+  // Cell size, 0 to use the average spring length
+  double cell_size = 0;
+  int max_cells = 64;
+
+  double target_density = 1.0; // particles per cell
+  double repulsion = 0;        // acceleration per unit of excess density
+  double smoothing = 0;        // blend towards grid velocity, 0 to 1
+
+  Vector3D light_direction = Vector3D(0.3, 1.0, 0.5);
+  double opacity = 0.5;        // extinction per particle per cell crossed
+
+private:
+  void weights(const Vector3D &p, int *nodes, double *w);
+
+  int nx = 0, ny = 0, nz = 0;
+  double cell = 1.0;
+  Vector3D grid_min;
+
+  vector<double> rho;
+  vector<double> mom_x;
+  vector<double> mom_y;
+  vector<double> mom_z;
+
+  // Density and momentum splatted by each thread, interleaved per node,
+  // zero between builds
+  vector<vector<double>> splats;
+};
+
+#endif //CLOTHSIM_HAIRGRID_H
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <getopt.h>
 #include <iostream>
 #include <fstream>
@@ -9,22 +10,21 @@
 
 #include "CGL/CGL.h"
 #include "clothSimulator.h"
-#include "json.hpp"
 #include "hair.h"
+#include "checkpoint.h"
+#include "playblast.h"
+#include "sceneLoader.h"
+#include "cloth.h"
+#include "strandSolver.h"
+#include "rootAnimation.h"
 
 typedef uint32_t gid_t;
 
 using namespace std;
 using namespace nanogui;
 
-using json = nlohmann::json;
-
 #define msg(s) cerr << "[ClothSim] " << s << endl;
 
-const string HAIR = "hair";
-
-const unordered_set<string> VALID_KEYS = {HAIR};
-
 ClothSimulator *app = nullptr;
 GLFWwindow *window = nullptr;
 Screen *screen = nullptr;
@@ -133,140 +133,63 @@ void usageError(const char *binaryName) {
   printf("Required program options:\n");
   printf("  -f     <STRING>    Filename of scene");
   printf("\n");
+  printf("Optional program options:\n");
+  printf("  -a     <STRING>    Filename of root animation keyframes");
+  printf("\n");
+  printf("  -c     <STRING>    Filename of checkpoint to start from");
+  printf("\n");
+  printf("  -p     <STRING>    Settle the groom first and save it as this checkpoint");
+  printf("\n");
+  printf("  -o     <STRING>    Prefix of screenshots and recorded frames");
+  printf("\n");
+  printf("  -x                 Capture frames as EXR instead of PNG");
+  printf("\n");
+  printf("  -b     <INT>       Render this many frames on the CPU without a window and exit");
+  printf("\n");
   exit(-1);
 }
 
-void incompleteObjectError(const char *object, const char *attribute) {
-  cout << "Incomplete " << object << " definition, missing " << attribute << endl;
-  exit(-1);
-}
-
-void loadObjectsFromFile(string filename, HairVector *hairs) {
-  // Read JSON from file
-  ifstream i(filename);
-  json j;
-  i >> j;
-
-  // Loop over objects in scene
-  for (json::iterator it = j.begin(); it != j.end(); ++it) {
-    string key = it.key();
-
-    // Check that object is valid
-    unordered_set<string>::const_iterator query = VALID_KEYS.find(key);
-    if (query == VALID_KEYS.end()) {
-      cout << "Invalid scene object found: " << key << endl;
-      exit(-1);
-    }
-
-    // Retrieve object
-    json object = it.value();
-
-    if (key == HAIR) {
-      for (json json_unit : object) {
-        int particles_count, num_hairs;
-        double length, density, ks, ab, kb, ac, kc, damping;
-
-        auto it_damping = json_unit.find("damping");
-        if (it_damping != json_unit.end()) {
-          damping = *it_damping;
-        } else {
-          incompleteObjectError("hair", "damping");
-        }
-
-        auto it_particles_count = json_unit.find("particles count");
-        if (it_particles_count != json_unit.end()) {
-          particles_count = *it_particles_count;
-        } else {
-          incompleteObjectError("hair", "particles count");
-        }
-
-        auto it_num_hairs = json_unit.find("num hairs");
-        if (it_num_hairs != json_unit.end()) {
-          num_hairs = *it_num_hairs;
-        } else {
-          incompleteObjectError("hair", "num hairs");
-        }
-
-        auto it_length = json_unit.find("length");
-        if (it_length != json_unit.end()) {
-          length = *it_length;
-        } else {
-          incompleteObjectError("hair", "length");
-        }
-
-        auto it_density = json_unit.find("density");
-        if (it_density != json_unit.end()) {
-          density = *it_density;
-        } else {
-          incompleteObjectError("hair", "density");
-        }
-
-        auto it_ks = json_unit.find("ks");
-        if (it_ks != json_unit.end()) {
-          ks = *it_ks;
-        } else {
-          incompleteObjectError("hair", "ks");
-        }
-
-        auto it_kb = json_unit.find("kb");
-        if (it_kb != json_unit.end()) {
-          kb = *it_kb;
-        } else {
-          incompleteObjectError("hair", "kb");
-        }
-
-        auto it_ab = json_unit.find("ab");
-        if (it_ab != json_unit.end()) {
-          ab = *it_ab;
-        } else {
-          incompleteObjectError("hair", "ab");
-        }
-
-        auto it_ac = json_unit.find("ac");
-        if (it_ac != json_unit.end()) {
-          ac = *it_ac;
-        } else {
-          incompleteObjectError("hair", "ac");
-        }
-
-        auto it_kc = json_unit.find("kc");
-        if (it_kc != json_unit.end()) {
-          kc = *it_kc;
-        } else {
-          incompleteObjectError("hair", "kc");
-        }
-
-        hairs->particles_count = particles_count;
-        hairs->length = length;
-        hairs->num_hairs = num_hairs;
-        hairs->density = density;
-        hairs->damping = damping;
-
-        hairs->ab = ab;
-        hairs->ac = ac;
-
-        hairs->ks = ks;
-        hairs->kb = kb;
-        hairs->kc = kc;
-      }
-    }
-  }
-  i.close();
-}
-
 int main(int argc, char **argv) {
-  HairVector hairs = HairVector();
+  HairVector hairs;
+  Cloth *cloth = new Cloth();
+  ClothParameters *cp = new ClothParameters();
+  vector<CollisionObject *> *objects = new vector<CollisionObject *>();
+  bool has_cloth = false;
+  string root_animation_file;
+  string checkpoint_file;
+  string preroll_file;
+  string capture_prefix;
+  bool capture_exr = false;
+  int playblast_frames = 0;
 
   if (argc == 1) { // No arguments, default initialization
     string default_file_name = "../scene/pinned2.json";
-    loadObjectsFromFile(default_file_name, &hairs);
+    loadObjectsFromFile(default_file_name, &hairs, cloth, cp, objects, &has_cloth);
   } else {
     int c;
 
-    while ((c = getopt (argc, argv, "f:")) != -1) {
+    while ((c = getopt (argc, argv, "f:a:c:p:o:xb:")) != -1) {
       switch (c) {
         case 'f':
-          loadObjectsFromFile(optarg, &hairs);
+          loadObjectsFromFile(optarg, &hairs, cloth, cp, objects, &has_cloth);
+          break;
+        case 'a':
+          root_animation_file = optarg;
+          break;
+        case 'c':
+          checkpoint_file = optarg;
+          break;
+        case 'p':
+          preroll_file = optarg;
+          break;
+        case 'o':
+          capture_prefix = optarg;
+          break;
+        case 'x':
+          capture_exr = true;
+          break;
+        case 'b':
+          playblast_frames = atoi(optarg);
           break;
         default:
           usageError(argv[0]);
@@ -276,20 +199,62 @@ int main(int argc, char **argv) {
 
   glfwSetErrorCallback(error_callback);
 
-  createGLContexts();
+  // Playblasts are drawn on the CPU and need no window
+  if (playblast_frames <= 0) {
+    createGLContexts();
+  }
+
+  buildScene(&hairs, cloth, cp, objects, has_cloth);
+
+  if (!checkpoint_file.empty() && !loadCheckpoint(checkpoint_file, &hairs)) {
+    exit(-1);
+  }
+
+  // Up to a minute of simulated time at the steps the viewer starts with,
+  // until no strand has more energy than a sleeping one
+  if (!preroll_file.empty()) {
+    int frames_per_sec = ClothSimulator::DEFAULT_FRAMES_PER_SEC;
+    int simulation_steps = ClothSimulator::DEFAULT_SIMULATION_STEPS;
+    auto start = chrono::steady_clock::now();
+    int steps = hairs.preroll(frames_per_sec, simulation_steps, {ClothSimulator::DEFAULT_GRAVITY},
+                              frames_per_sec * simulation_steps * 60, hairs.sleep_energy);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Settled in " << steps << " steps, " << seconds << " s" << endl;
+    if (!saveCheckpoint(preroll_file, &hairs)) {
+      exit(-1);
+    }
+    checkpoint_file = preroll_file;
+  }
 
-  // Initialize the Hair object
-  Vector3D start_pos = Vector3D();
-  for (int i = 0; i < hairs.num_hairs; i++) {
-    start_pos.x = 3.0 * (i % 5) + ((double) rand() * 2.0 / RAND_MAX);
-    start_pos.y = 3.0 * (i / 5) + ((double) rand() * 2.0 / RAND_MAX);
-    hairs.buildGrid(start_pos);
+  if (!root_animation_file.empty()) {
+    hairs.root_animation = new RootAnimation();
+    if (!hairs.root_animation->load(root_animation_file)) {
+      exit(-1);
+    }
+    hairs.root_animation->bind(&hairs);
+  }
+
+  if (playblast_frames > 0) {
+    string prefix = capture_prefix.empty() ? "playblast" : capture_prefix;
+    return playblast(&hairs, cloth, cp, objects, playblast_frames, prefix) ? 0 : -1;
   }
 
   // Initialize the ClothSimulator object
   app = new ClothSimulator(screen);
 
   app->loadHair(&hairs);
+  app->loadCloth(cloth);
+  app->loadClothParameters(cp);
+  app->loadCollisionObjects(objects);
+  if (!checkpoint_file.empty()) {
+    app->checkpoint_file = checkpoint_file;
+  }
+  if (!capture_prefix.empty()) {
+    app->capture_prefix = capture_prefix;
+  }
+  if (capture_exr) {
+    app->capture_format = FrameCapture::EXR;
+  }
   app->init();
 
   // Call this after all the widgets have been defined
@@ -320,5 +285,7 @@ int main(int argc, char **argv) {
     }
   }
 
+  app->finishCapture();
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include "massSpringSolver.h"
+#include "HairVector.h"
+
+using namespace std;
+
+void MassSpringSolver::step(HairVector *hairs, Hair *hair, int index,
+                            double frames_per_sec, double simulation_steps) {
+  hair->restCoreSmoothingFunction(hairs->ac);
+  hair->springForces(frames_per_sec, simulation_steps, hairs->enable_stretch_constraints,
+                     hairs->enable_support_constraints, hairs->ks, hairs->cs, hairs->kb,
+                     hairs->cb, hairs->drag, hairs->ab);
+  if (hairs->enable_bending_constraints) {
+    hair->bendSpring(frames_per_sec, simulation_steps, hairs->kb, hairs->cb);
+  }
+  if (hairs->enable_core_constraints) {
+    hair->coreSpring(frames_per_sec, simulation_steps, hairs->kc, hairs->cc, hairs->ac);
+  }
+  hair->updatePositions(frames_per_sec, simulation_steps, hairs->density, hairs->damping,
+                        hairs->projection_levels, hairs->enable_tethers);
+}
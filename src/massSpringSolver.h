@@ -0,0 +1,20 @@
+#ifndef CLOTHSIM_MASSSPRINGSOLVER_H
+#define CLOTHSIM_MASSSPRINGSOLVER_H
+
+#include "strandSolver.h"
+
+/**
+ * The original strand model: stretch and support springs, bending towards
+ * the transported rest frames and core springs towards the smoothed rest
+ * shape, integrated with Verlet and strain limited. All coefficients come
+ * from the HairVector.
+ */
+class MassSpringSolver : public StrandSolver {
+public:
+  string name() { return "mass spring"; }
+
+  void step(HairVector *hairs, Hair *hair, int index,
+            double frames_per_sec, double simulation_steps);
+};
+
+#endif //CLOTHSIM_MASSSPRINGSOLVER_H
@@ -0,0 +1,126 @@
+#include <stdio.h>
+
+#include <chrono>
+#include <iostream>
+
+#include "playblast.h"
+
+#include "clothSimulator.h"
+#include "hairGrid.h"
+#include "softwareRasterizer.h"
+
+// The viewer's default window size
+static const int WIDTH = 1024;
+static const int HEIGHT = 800;
+
+// The disc ClothSimulator::drawHead draws
+static void addHead(SoftwareRasterizer &rasterizer, HairVector *hairs) {
+  if (hairs->hair_vector->empty()) return;
+
+  Vector3D center = Vector3D();
+  for (Hair *hair : *(hairs->hair_vector)) {
+    center += hair->point_masses[0].position;
+  }
+  center /= hairs->hair_vector->size();
+
+  int num_tris = 25;
+  double theta = 2.0 * PI / num_tris;
+  double s = 10.0;
+  CGL::Color skin(239.0f / 255, 209.0f / 255, 199.0f / 255, 1.0f);
+  for (int j = 0; j < num_tris; j++) {
+    Vector3D a(center.x, center.y, -1.0);
+    Vector3D b(center.x + s * cos(j * theta), center.y + s * sin(j * theta), -1.0);
+    Vector3D c(center.x + s * cos((j + 1) * theta), center.y + s * sin((j + 1) * theta), -1.0);
+    rasterizer.addTriangle(a, b, c, skin);
+  }
+}
+
+static void addHair(SoftwareRasterizer &rasterizer, HairVector *hairs) {
+  vector<Hair *> &strands = *hairs->hair_vector;
+  int num_strands = strands.size();
+
+  // Darken strands by their mean deep opacity shadow
+  vector<float> shade(num_strands, 1.0f);
+  if (hairs->volume) {
+#pragma omp parallel for
+    for (int s = 0; s < num_strands; s++) {
+      double transmittance = 0;
+      for (PointMass &pm : strands[s]->point_masses) {
+        transmittance += hairs->volume->transmittance(pm.position);
+      }
+      shade[s] = (float) (0.35 + 0.65 * transmittance / strands[s]->point_masses.size());
+    }
+  }
+
+  vector<Vector3D> points;
+  for (int s = 0; s < num_strands; s++) {
+    points.clear();
+    for (PointMass &pm : strands[s]->point_masses) {
+      points.push_back(pm.smoothed_position);
+    }
+    rasterizer.addLineStrip(points, CGL::Color(0.698f * shade[s], 0.133f * shade[s],
+                                          0.133f * shade[s], 1.0f));
+  }
+}
+
+// Structural and shearing springs, like ClothSimulator::drawCloth
+static void addCloth(SoftwareRasterizer &rasterizer, Cloth *cloth) {
+  if (!cloth) return;
+
+  CGL::Color white(1.0f, 1.0f, 1.0f, 1.0f);
+  for (int type : {STRUCTURAL, SHEARING}) {
+    ClothSprings &set = cloth->springs[type];
+    for (int k = 0; k < set.pm_a.size(); k++) {
+      rasterizer.addLine(cloth->point_masses[set.pm_a[k]].position,
+                         cloth->point_masses[set.pm_b[k]].position, white);
+    }
+  }
+}
+
+bool playblast(HairVector *hairs, Cloth *cloth, ClothParameters *cp,
+               vector<CollisionObject *> *objects, int frames, const string &prefix) {
+  CGL::Camera camera;
+  ClothSimulator::placeCamera(hairs, cloth, camera, WIDTH, HEIGHT);
+
+  SoftwareRasterizer rasterizer(WIDTH, HEIGHT);
+  rasterizer.setViewProjection(ClothSimulator::projectionMatrix(camera) *
+                               ClothSimulator::viewMatrix(camera));
+
+  // The viewer's defaults
+  int frames_per_sec = ClothSimulator::DEFAULT_FRAMES_PER_SEC;
+  int simulation_steps = ClothSimulator::DEFAULT_SIMULATION_STEPS;
+  vector<Vector3D> external_accelerations = {ClothSimulator::DEFAULT_GRAVITY};
+
+  double render_seconds = 0;
+  for (int f = 0; f < frames; f++) {
+    hairs->updateLOD(camera.position());
+    for (int i = 0; i < simulation_steps; i++) {
+      hairs->simulate(frames_per_sec, simulation_steps, external_accelerations);
+    }
+    if (cloth) {
+      for (int i = 0; i < simulation_steps; i++) {
+        cloth->simulate(frames_per_sec, simulation_steps, cp, external_accelerations, objects);
+      }
+    }
+    hairs->frame++;
+
+    auto start = chrono::steady_clock::now();
+    rasterizer.clear(CGL::Color(0.25f, 0.25f, 0.25f, 1.0f));
+    addHead(rasterizer, hairs);
+    addHair(rasterizer, hairs);
+    addCloth(rasterizer, cloth);
+    rasterizer.render();
+    render_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s_%05d.png", prefix.c_str(), f);
+    if (!rasterizer.save(filename)) {
+      cout << "Could not write " << filename << endl;
+      return false;
+    }
+  }
+
+  cout << "Rendered " << frames << " frames, " << 1e3 * render_seconds / max(frames, 1)
+       << " ms per frame" << endl;
+  return true;
+}
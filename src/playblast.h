@@ -0,0 +1,25 @@
+#ifndef CLOTHSIM_PLAYBLAST_H
+#define CLOTHSIM_PLAYBLAST_H
+
+#include <string>
+#include <vector>
+
+#include "HairVector.h"
+#include "cloth.h"
+#include "collision/collisionObject.h"
+
+using namespace std;
+
+/**
+ * Preview movie frames for machines without a GPU or display: simulates
+ * frames with the viewer's default settings and draws each one with the
+ * software rasterizer into <prefix>_<00000>.png.
+ *
+ * The camera and image size are those the viewer starts out with. Strands
+ * are polylines through their smoothed positions, shaded by the volume like
+ * in the viewer, drawn with the head disc and the cloth springs.
+ */
+bool playblast(HairVector *hairs, Cloth *cloth, ClothParameters *cp,
+               vector<CollisionObject *> *objects, int frames, const string &prefix);
+
+#endif //CLOTHSIM_PLAYBLAST_H
@@ -4,6 +4,8 @@
 #include <sstream>
 #include <iostream>
 
+#include "CGL/lodepng.h"
+
 using namespace std;
 
 namespace CGL {
@@ -555,7 +557,10 @@ int PNGParser::load(const char* filename, PNG& png) {
 }
 
 int PNGParser::save(const char *filename, const PNG& png) {
-  return 0;
+
+  // pixels are 32 bit RGBA, top row first
+  return lodepng::encode(filename, png.pixels, png.width, png.height);
+
 }
 
 
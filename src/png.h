@@ -1,6 +1,7 @@
 #ifndef CGL_PNG_H
 #define CGL_PNG_H
 
+#include <cstddef>
 #include <map>
 #include <vector>
 
@@ -7,16 +7,11 @@
 
 using namespace CGL;
 
-// Forward declarations
-class Halfedge;
-class Edge;
-
 struct PointMass {
 PointMass(Vector3D position, bool pinned)
         : pinned(pinned), start_position(position), position(position),
           last_position(position) {}
 
-Vector3D normal();
 Vector3D velocity(double delta_t) {
   return (position - last_position) / delta_t;
 }
@@ -43,9 +38,6 @@ Vector3D smoothed_velocity;
 Vector3D bend_target_pos;
 Vector3D frame_1;
 Vector3D frame_2;
-
-// mesh reference
-Halfedge *halfedge;
 };
 
 #endif /* POINTMASS_H */
\ No newline at end of file
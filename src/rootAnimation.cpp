@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+
+#include "CGL/misc.h"
+#include "json.hpp"
+#include "rootAnimation.h"
+
+using namespace std;
+
+using json = nlohmann::json;
+
+bool RootAnimation::load(const string &filename) {
+  ifstream i(filename);
+  if (!i.good()) {
+    cout << "Could not open root animation " << filename << endl;
+    return false;
+  }
+
+  json j;
+  i >> j;
+  i.close();
+
+  auto it_loop = j.find("loop");
+  if (it_loop != j.end()) {
+    loop = *it_loop;
+  }
+
+  auto it_bones = j.find("bones");
+  if (it_bones == j.end() || it_bones->empty()) {
+    cout << "Root animation " << filename << " has no bones" << endl;
+    return false;
+  }
+
+  for (json json_bone : *it_bones) {
+    RootBone bone;
+
+    auto it_pivot = json_bone.find("pivot");
+    if (it_pivot != json_bone.end()) {
+      vector<double> pivot = *it_pivot;
+      bone.pivot = Vector3D(pivot[0], pivot[1], pivot[2]);
+      bone.has_pivot = true;
+    }
+
+    auto it_strands = json_bone.find("strands");
+    if (it_strands != json_bone.end()) {
+      vector<int> strands = *it_strands;
+      bone.strands = strands;
+    }
+
+    auto it_keyframes = json_bone.find("keyframes");
+    if (it_keyframes == json_bone.end() || it_keyframes->empty()) {
+      cout << "Root animation bone without keyframes" << endl;
+      return false;
+    }
+
+    for (json json_key : *it_keyframes) {
+      RootKeyframe key;
+      key.time = json_key.value("time", 0.0);
+
+      auto it_translation = json_key.find("translation");
+      if (it_translation != json_key.end()) {
+        vector<double> t = *it_translation;
+        key.translation = Vector3D(t[0], t[1], t[2]);
+      }
+
+      auto it_rotation = json_key.find("rotation");
+      if (it_rotation != json_key.end()) {
+        vector<double> r = *it_rotation;
+        key.rotation.from_axis_angle(Vector3D(r[0], r[1], r[2]), radians(r[3]));
+      }
+
+      bone.keyframes.push_back(key);
+    }
+
+    sort(bone.keyframes.begin(), bone.keyframes.end(),
+         [](const RootKeyframe &a, const RootKeyframe &b) { return a.time < b.time; });
+    bones.push_back(bone);
+  }
+
+  return true;
+}
+
+void RootAnimation::bind(HairVector *hairs) {
+  int num_strands = hairs->hair_vector->size();
+
+  // Strands not claimed by any bone follow the first one
+  vector<bool> bound(num_strands, false);
+  for (RootBone &bone : bones) {
+    vector<int> strands;
+    for (int s : bone.strands) {
+      if (s >= 0 && s < num_strands && !bound[s]) {
+        bound[s] = true;
+        strands.push_back(s);
+      }
+    }
+    bone.strands = strands;
+  }
+  for (int s = 0; s < num_strands; s++) {
+    if (!bound[s]) bones[0].strands.push_back(s);
+  }
+
+  for (RootBone &bone : bones) {
+    bone.rest_x.clear();
+    bone.rest_y.clear();
+    bone.rest_z.clear();
+
+    Vector3D centroid;
+    for (int s : bone.strands) {
+      Vector3D p = (*hairs->hair_vector)[s]->point_masses[0].start_position;
+      bone.rest_x.push_back(p.x);
+      bone.rest_y.push_back(p.y);
+      bone.rest_z.push_back(p.z);
+      centroid += p;
+    }
+
+    if (!bone.has_pivot && !bone.strands.empty()) {
+      bone.pivot = centroid / bone.strands.size();
+    }
+  }
+}
+
+void RootAnimation::sample(const RootBone &bone, double time,
+                           Vector3D &translation, Quaternion &rotation) {
+  const vector<RootKeyframe> &keys = bone.keyframes;
+  double start = keys.front().time;
+  double end = keys.back().time;
+
+  if (loop && end > start) {
+    time = start + fmod(time - start, end - start);
+    if (time < start) time += end - start;
+  }
+
+  if (time <= start) {
+    translation = keys.front().translation;
+    rotation = keys.front().rotation;
+    return;
+  }
+  if (time >= end) {
+    translation = keys.back().translation;
+    rotation = keys.back().rotation;
+    return;
+  }
+
+  int k = 0;
+  while (keys[k+1].time < time) {
+    k++;
+  }
+
+  const RootKeyframe &a = keys[k];
+  const RootKeyframe &b = keys[k+1];
+  double t = (time - a.time) / (b.time - a.time);
+
+  // Take the short way around
+  Quaternion rb = b.rotation;
+  if (a.rotation.x * rb.x + a.rotation.y * rb.y + a.rotation.z * rb.z + a.rotation.w * rb.w < 0) {
+    rb = Quaternion(-rb.x, -rb.y, -rb.z, -rb.w);
+  }
+
+  translation = (1.0 - t) * a.translation + t * b.translation;
+  rotation = Quaternion::slerp(a.rotation, rb, t);
+  rotation.normalize();
+}
+
+void RootAnimation::apply(HairVector *hairs, double time) {
+  for (RootBone &bone : bones) {
+    Vector3D translation;
+    Quaternion rotation;
+    sample(bone, time, translation, rotation);
+
+    // p' = R (p - pivot) + pivot + t = R p + c
+    Matrix3x3 R = rotation.rotationMatrix();
+    Vector3D c = bone.pivot + translation - R * bone.pivot;
+
+    double m00 = R(0, 0), m01 = R(0, 1), m02 = R(0, 2);
+    double m10 = R(1, 0), m11 = R(1, 1), m12 = R(1, 2);
+    double m20 = R(2, 0), m21 = R(2, 1), m22 = R(2, 2);
+
+    int n = bone.strands.size();
+    const double *x = bone.rest_x.data();
+    const double *y = bone.rest_y.data();
+    const double *z = bone.rest_z.data();
+
+    for (int i = 0; i < n; i++) {
+      Hair *hair = (*hairs->hair_vector)[bone.strands[i]];
+      hair->root_rotation = R;
+      PointMass &root = hair->point_masses[0];
+      root.last_position = root.position;
+      root.position.x = m00 * x[i] + m01 * y[i] + m02 * z[i] + c.x;
+      root.position.y = m10 * x[i] + m11 * y[i] + m12 * z[i] + c.y;
+      root.position.z = m20 * x[i] + m21 * y[i] + m22 * z[i] + c.z;
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef CLOTHSIM_ROOTANIMATION_H
+#define CLOTHSIM_ROOTANIMATION_H
+
+#include <string>
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "CGL/quaternion.h"
+#include "HairVector.h"
+
+using namespace CGL;
+using namespace std;
+
+struct RootKeyframe {
+  double time;
+  Vector3D translation;
+  Quaternion rotation;
+};
+
+/**
+ * A rigid transform track that a set of strand roots is skinned to. Roots
+ * rotate about the pivot and are then translated.
+ */
+struct RootBone {
+  Vector3D pivot;
+  bool has_pivot = false;
+  vector<int> strands;
+  vector<RootKeyframe> keyframes;
+
+  // Rest root positions of the bound strands, one array per coordinate
+  vector<double> rest_x;
+  vector<double> rest_y;
+  vector<double> rest_z;
+};
+
+/**
+ * Moves the pinned strand roots along keyframed bone transforms.
+ *
+ * The keyframe file is JSON:
+ *
+ *   { "loop": true,
+ *     "bones": [ { "pivot": [x, y, z],
+ *                  "strands": [0, 1, 2],
+ *                  "keyframes": [ { "time": 0.0,
+ *                                   "translation": [x, y, z],
+ *                                   "rotation": [ax, ay, az, degrees] } ] } ] }
+ *
+ * Strands not listed by any bone are bound to the first one; the pivot
+ * defaults to the centroid of the bound roots.
+ */
+class RootAnimation {
+public:
+  bool load(const string &filename);
+  void bind(HairVector *hairs);
+
+  // Moves the roots to their pose at the given time. The previous root
+  // position becomes last_position, so the root velocity over the substep
+  // is picked up by the Verlet state.
+  void apply(HairVector *hairs, double time);
+
+  bool loop = false;
+  vector<RootBone> bones;
+
+private:
+  void sample(const RootBone &bone, double time, Vector3D &translation,
+              Quaternion &rotation);
+};
+
+#endif //CLOTHSIM_ROOTANIMATION_H
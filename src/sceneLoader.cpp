@@ -0,0 +1,619 @@
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+
+#include "sceneLoader.h"
+#include "json.hpp"
+#include "forceField.h"
+#include "hairGrid.h"
+#include "elasticRod.h"
+#include "strandSolver.h"
+#include "collision/capsule.h"
+#include "collision/obb.h"
+#include "collision/plane.h"
+#include "collision/sphere.h"
+
+using namespace std;
+
+using json = nlohmann::json;
+
+const string HAIR = "hair";
+const string FORCE_FIELD = "force field";
+const string CLOTH = "cloth";
+const string SPHERE = "sphere";
+const string PLANE = "plane";
+const string CAPSULE = "capsule";
+const string BOX = "box";
+
+const unordered_set<string> VALID_KEYS = {HAIR, FORCE_FIELD, CLOTH, SPHERE, PLANE, CAPSULE, BOX};
+
+static void incompleteObjectError(const char *object, const char *attribute) {
+  cout << "Incomplete " << object << " definition, missing " << attribute << endl;
+  exit(-1);
+}
+
+// Collider keys take one object or an array of them
+static vector<json> objectList(const json &object) {
+  if (object.is_array()) {
+    return object.get<vector<json>>();
+  }
+  return {object};
+}
+
+void loadObjectsFromFile(string filename, HairVector *hairs, Cloth *cloth, ClothParameters *cp,
+                         vector<CollisionObject *> *objects, bool *has_cloth) {
+  // Read JSON from file
+  ifstream i(filename);
+  json j;
+  i >> j;
+
+  // Loop over objects in scene
+  for (json::iterator it = j.begin(); it != j.end(); ++it) {
+    string key = it.key();
+
+    // Check that object is valid
+    unordered_set<string>::const_iterator query = VALID_KEYS.find(key);
+    if (query == VALID_KEYS.end()) {
+      cout << "Invalid scene object found: " << key << endl;
+      exit(-1);
+    }
+
+    // Retrieve object
+    json object = it.value();
+
+    if (key == HAIR) {
+      for (json json_unit : object) {
+        int particles_count, num_hairs;
+        double length, density, ks, ab, kb, ac, kc, damping;
+
+        auto it_damping = json_unit.find("damping");
+        if (it_damping != json_unit.end()) {
+          damping = *it_damping;
+        } else {
+          incompleteObjectError("hair", "damping");
+        }
+
+        auto it_particles_count = json_unit.find("particles count");
+        if (it_particles_count != json_unit.end()) {
+          particles_count = *it_particles_count;
+        } else {
+          incompleteObjectError("hair", "particles count");
+        }
+
+        auto it_num_hairs = json_unit.find("num hairs");
+        if (it_num_hairs != json_unit.end()) {
+          num_hairs = *it_num_hairs;
+        } else {
+          incompleteObjectError("hair", "num hairs");
+        }
+
+        auto it_length = json_unit.find("length");
+        if (it_length != json_unit.end()) {
+          length = *it_length;
+        } else {
+          incompleteObjectError("hair", "length");
+        }
+
+        auto it_density = json_unit.find("density");
+        if (it_density != json_unit.end()) {
+          density = *it_density;
+        } else {
+          incompleteObjectError("hair", "density");
+        }
+
+        auto it_ks = json_unit.find("ks");
+        if (it_ks != json_unit.end()) {
+          ks = *it_ks;
+        } else {
+          incompleteObjectError("hair", "ks");
+        }
+
+        auto it_kb = json_unit.find("kb");
+        if (it_kb != json_unit.end()) {
+          kb = *it_kb;
+        } else {
+          incompleteObjectError("hair", "kb");
+        }
+
+        auto it_ab = json_unit.find("ab");
+        if (it_ab != json_unit.end()) {
+          ab = *it_ab;
+        } else {
+          incompleteObjectError("hair", "ab");
+        }
+
+        auto it_ac = json_unit.find("ac");
+        if (it_ac != json_unit.end()) {
+          ac = *it_ac;
+        } else {
+          incompleteObjectError("hair", "ac");
+        }
+
+        auto it_kc = json_unit.find("kc");
+        if (it_kc != json_unit.end()) {
+          kc = *it_kc;
+        } else {
+          incompleteObjectError("hair", "kc");
+        }
+
+        auto it_cs = json_unit.find("cs");
+        if (it_cs != json_unit.end()) {
+          hairs->cs = *it_cs;
+        }
+
+        auto it_cb = json_unit.find("cb");
+        if (it_cb != json_unit.end()) {
+          hairs->cb = *it_cb;
+        }
+
+        auto it_cc = json_unit.find("cc");
+        if (it_cc != json_unit.end()) {
+          hairs->cc = *it_cc;
+        }
+
+        auto it_drag = json_unit.find("drag");
+        if (it_drag != json_unit.end()) {
+          hairs->drag = *it_drag;
+        }
+
+        auto it_projection_levels = json_unit.find("projection levels");
+        if (it_projection_levels != json_unit.end()) {
+          hairs->projection_levels = *it_projection_levels;
+          if (hairs->projection_levels < 0) {
+            cout << "Invalid projection levels: " << hairs->projection_levels << endl;
+            exit(-1);
+          }
+        }
+
+        auto it_tethers = json_unit.find("tethers");
+        if (it_tethers != json_unit.end()) {
+          hairs->enable_tethers = *it_tethers;
+        }
+
+        auto it_volume_repulsion = json_unit.find("volume repulsion");
+        auto it_volume_smoothing = json_unit.find("volume smoothing");
+        auto it_volume_density = json_unit.find("volume density");
+        auto it_shadow_opacity = json_unit.find("shadow opacity");
+        if (it_volume_repulsion != json_unit.end() || it_volume_smoothing != json_unit.end() ||
+            it_shadow_opacity != json_unit.end()) {
+          hairs->volume = new HairGrid();
+          if (it_volume_repulsion != json_unit.end()) hairs->volume->repulsion = *it_volume_repulsion;
+          if (it_volume_smoothing != json_unit.end()) hairs->volume->smoothing = *it_volume_smoothing;
+          if (it_volume_density != json_unit.end()) hairs->volume->target_density = *it_volume_density;
+          if (it_shadow_opacity != json_unit.end()) hairs->volume->opacity = *it_shadow_opacity;
+        }
+
+        auto it_lod_distance = json_unit.find("lod distance");
+        if (it_lod_distance != json_unit.end()) {
+          hairs->lod_distance = *it_lod_distance;
+          hairs->enable_lod = true;
+        }
+
+        auto it_particle_budget = json_unit.find("particle budget");
+        if (it_particle_budget != json_unit.end()) {
+          hairs->particle_budget = *it_particle_budget;
+          hairs->enable_lod = true;
+        }
+
+        auto it_sleep_energy = json_unit.find("sleep energy");
+        if (it_sleep_energy != json_unit.end()) {
+          hairs->sleep_energy = *it_sleep_energy;
+          hairs->enable_sleep = true;
+        }
+
+        auto it_seed = json_unit.find("seed");
+        if (it_seed != json_unit.end()) {
+          unsigned int seed = *it_seed;
+          hairs->rng.seed(seed);
+        }
+
+        auto it_engine = json_unit.find("engine");
+        if (it_engine != json_unit.end()) {
+          string engine = *it_engine;
+          hairs->solver = hairs->solverNamed(engine);
+          if (!hairs->solver) {
+            cout << "Invalid hair engine: " << engine << endl;
+            exit(-1);
+          }
+        }
+
+        ElasticRods *rods = dynamic_cast<ElasticRods *>(hairs->solver);
+        if (rods) {
+          auto it_rod_stretching = json_unit.find("rod stretching");
+          if (it_rod_stretching != json_unit.end()) rods->stretching = *it_rod_stretching;
+          auto it_rod_bending = json_unit.find("rod bending");
+          if (it_rod_bending != json_unit.end()) rods->bending = *it_rod_bending;
+          auto it_rod_twisting = json_unit.find("rod twisting");
+          if (it_rod_twisting != json_unit.end()) rods->twisting = *it_rod_twisting;
+        }
+
+        hairs->particles_count = particles_count;
+        hairs->length = length;
+        hairs->num_hairs = num_hairs;
+        hairs->density = density;
+        hairs->damping = damping;
+
+        hairs->ab = ab;
+        hairs->ac = ac;
+
+        hairs->ks = ks;
+        hairs->kb = kb;
+        hairs->kc = kc;
+      }
+    } else if (key == FORCE_FIELD) {
+      if (!hairs->force_fields) {
+        hairs->force_fields = new ForceFields();
+      }
+
+      for (json json_unit : object) {
+        ForceField field;
+
+        auto it_type = json_unit.find("type");
+        if (it_type != json_unit.end()) {
+          string type = *it_type;
+          if (type == "wind") {
+            field.type = WIND;
+          } else if (type == "vortex") {
+            field.type = VORTEX;
+          } else if (type == "turbulence") {
+            field.type = TURBULENCE;
+          } else {
+            cout << "Invalid force field type: " << type << endl;
+            exit(-1);
+          }
+        } else {
+          incompleteObjectError("force field", "type");
+        }
+
+        auto it_strength = json_unit.find("strength");
+        if (it_strength != json_unit.end()) {
+          field.strength = *it_strength;
+        } else {
+          incompleteObjectError("force field", "strength");
+        }
+
+        auto it_direction = json_unit.find("direction");
+        if (it_direction != json_unit.end()) {
+          vector<double> vec_direction = *it_direction;
+          field.direction = Vector3D(vec_direction[0], vec_direction[1], vec_direction[2]);
+        }
+        // Wind and vortices use it normalized; turbulence only drifts along it
+        if (field.type != TURBULENCE && field.direction.norm2() == 0) {
+          cout << "Invalid force field direction: zero vector" << endl;
+          exit(-1);
+        }
+
+        auto it_center = json_unit.find("center");
+        if (it_center != json_unit.end()) {
+          vector<double> vec_center = *it_center;
+          field.center = Vector3D(vec_center[0], vec_center[1], vec_center[2]);
+        }
+
+        auto it_radius = json_unit.find("radius");
+        if (it_radius != json_unit.end()) {
+          field.radius = *it_radius;
+        }
+
+        auto it_frequency = json_unit.find("frequency");
+        if (it_frequency != json_unit.end()) {
+          field.frequency = *it_frequency;
+        }
+
+        auto it_speed = json_unit.find("speed");
+        if (it_speed != json_unit.end()) {
+          field.speed = *it_speed;
+        }
+
+        hairs->force_fields->fields.push_back(field);
+      }
+    } else if (key == CLOTH) {
+      double width, height;
+      int num_width_points, num_height_points;
+      float thickness;
+      e_orientation orientation;
+      vector<vector<int>> pinned;
+
+      auto it_width = object.find("width");
+      if (it_width != object.end()) {
+        width = *it_width;
+      } else {
+        incompleteObjectError("cloth", "width");
+      }
+
+      auto it_height = object.find("height");
+      if (it_height != object.end()) {
+        height = *it_height;
+      } else {
+        incompleteObjectError("cloth", "height");
+      }
+
+      auto it_num_width_points = object.find("num_width_points");
+      if (it_num_width_points != object.end()) {
+        num_width_points = *it_num_width_points;
+        if (num_width_points < 2) {
+          cout << "Invalid cloth num_width_points: " << num_width_points << endl;
+          exit(-1);
+        }
+      } else {
+        incompleteObjectError("cloth", "num_width_points");
+      }
+
+      auto it_num_height_points = object.find("num_height_points");
+      if (it_num_height_points != object.end()) {
+        num_height_points = *it_num_height_points;
+        if (num_height_points < 2) {
+          cout << "Invalid cloth num_height_points: " << num_height_points << endl;
+          exit(-1);
+        }
+      } else {
+        incompleteObjectError("cloth", "num_height_points");
+      }
+
+      auto it_thickness = object.find("thickness");
+      if (it_thickness != object.end()) {
+        thickness = *it_thickness;
+      } else {
+        incompleteObjectError("cloth", "thickness");
+      }
+
+      auto it_orientation = object.find("orientation");
+      if (it_orientation != object.end()) {
+        int value = *it_orientation;
+        if (value != HORIZONTAL && value != VERTICAL) {
+          cout << "Invalid cloth orientation: " << value << endl;
+          exit(-1);
+        }
+        orientation = (e_orientation) value;
+      } else {
+        incompleteObjectError("cloth", "orientation");
+      }
+
+      auto it_pinned = object.find("pinned");
+      if (it_pinned != object.end()) {
+        vector<json> points = *it_pinned;
+        for (auto pt : points) {
+          vector<int> point = pt;
+          if (point.size() != 2 || point[0] < 0 || point[0] >= num_width_points ||
+              point[1] < 0 || point[1] >= num_height_points) {
+            cout << "Invalid pinned cloth point: " << pt << endl;
+            exit(-1);
+          }
+          pinned.push_back(point);
+        }
+      }
+
+      cloth->width = width;
+      cloth->height = height;
+      cloth->num_width_points = num_width_points;
+      cloth->num_height_points = num_height_points;
+      cloth->thickness = thickness;
+      cloth->orientation = orientation;
+      cloth->pinned = pinned;
+
+      // Cloth parameters
+      bool enable_structural_constraints, enable_shearing_constraints, enable_bending_constraints;
+      double damping, density, ks;
+
+      auto it_enable_structural = object.find("enable_structural");
+      if (it_enable_structural != object.end()) {
+        enable_structural_constraints = *it_enable_structural;
+      } else {
+        incompleteObjectError("cloth", "enable_structural");
+      }
+
+      auto it_enable_shearing = object.find("enable_shearing");
+      if (it_enable_shearing != object.end()) {
+        enable_shearing_constraints = *it_enable_shearing;
+      } else {
+        incompleteObjectError("cloth", "enable_shearing");
+      }
+
+      auto it_enable_bending = object.find("enable_bending");
+      if (it_enable_bending != object.end()) {
+        enable_bending_constraints = *it_enable_bending;
+      } else {
+        incompleteObjectError("cloth", "enable_bending");
+      }
+
+      auto it_damping = object.find("damping");
+      if (it_damping != object.end()) {
+        damping = *it_damping;
+      } else {
+        incompleteObjectError("cloth", "damping");
+      }
+
+      auto it_density = object.find("density");
+      if (it_density != object.end()) {
+        density = *it_density;
+      } else {
+        incompleteObjectError("cloth", "density");
+      }
+
+      auto it_ks = object.find("ks");
+      if (it_ks != object.end()) {
+        ks = *it_ks;
+      } else {
+        incompleteObjectError("cloth", "ks");
+      }
+
+      cp->enable_structural_constraints = enable_structural_constraints;
+      cp->enable_shearing_constraints = enable_shearing_constraints;
+      cp->enable_bending_constraints = enable_bending_constraints;
+      cp->density = density;
+      cp->damping = damping;
+      cp->ks = ks;
+
+      *has_cloth = true;
+    } else if (key == SPHERE) {
+      for (json json_unit : objectList(object)) {
+        Vector3D origin;
+        double radius, friction;
+
+        auto it_origin = json_unit.find("origin");
+        if (it_origin != json_unit.end()) {
+          vector<double> vec_origin = *it_origin;
+          origin = Vector3D(vec_origin[0], vec_origin[1], vec_origin[2]);
+        } else {
+          incompleteObjectError("sphere", "origin");
+        }
+
+        auto it_radius = json_unit.find("radius");
+        if (it_radius != json_unit.end()) {
+          radius = *it_radius;
+        } else {
+          incompleteObjectError("sphere", "radius");
+        }
+
+        auto it_friction = json_unit.find("friction");
+        if (it_friction != json_unit.end()) {
+          friction = *it_friction;
+        } else {
+          incompleteObjectError("sphere", "friction");
+        }
+
+        objects->push_back(new Sphere(origin, radius, friction));
+      }
+    } else if (key == PLANE) {
+      for (json json_unit : objectList(object)) {
+        Vector3D point, normal;
+        double friction;
+
+        auto it_point = json_unit.find("point");
+        if (it_point != json_unit.end()) {
+          vector<double> vec_point = *it_point;
+          point = Vector3D(vec_point[0], vec_point[1], vec_point[2]);
+        } else {
+          incompleteObjectError("plane", "point");
+        }
+
+        auto it_normal = json_unit.find("normal");
+        if (it_normal != json_unit.end()) {
+          vector<double> vec_normal = *it_normal;
+          normal = Vector3D(vec_normal[0], vec_normal[1], vec_normal[2]).unit();
+        } else {
+          incompleteObjectError("plane", "normal");
+        }
+
+        auto it_friction = json_unit.find("friction");
+        if (it_friction != json_unit.end()) {
+          friction = *it_friction;
+        } else {
+          incompleteObjectError("plane", "friction");
+        }
+
+        objects->push_back(new Plane(point, normal, friction));
+      }
+    } else if (key == CAPSULE) {
+      for (json json_unit : objectList(object)) {
+        Vector3D start, end;
+        double radius, friction;
+
+        auto it_start = json_unit.find("start");
+        if (it_start != json_unit.end()) {
+          vector<double> vec_start = *it_start;
+          start = Vector3D(vec_start[0], vec_start[1], vec_start[2]);
+        } else {
+          incompleteObjectError("capsule", "start");
+        }
+
+        auto it_end = json_unit.find("end");
+        if (it_end != json_unit.end()) {
+          vector<double> vec_end = *it_end;
+          end = Vector3D(vec_end[0], vec_end[1], vec_end[2]);
+        } else {
+          incompleteObjectError("capsule", "end");
+        }
+
+        auto it_radius = json_unit.find("radius");
+        if (it_radius != json_unit.end()) {
+          radius = *it_radius;
+        } else {
+          incompleteObjectError("capsule", "radius");
+        }
+
+        auto it_friction = json_unit.find("friction");
+        if (it_friction != json_unit.end()) {
+          friction = *it_friction;
+        } else {
+          incompleteObjectError("capsule", "friction");
+        }
+
+        objects->push_back(new Capsule(start, end, radius, friction));
+      }
+    } else if (key == BOX) {
+      for (json json_unit : objectList(object)) {
+        Vector3D center, half_extents;
+        Vector3D x_axis(1, 0, 0), y_axis(0, 1, 0);
+        double friction;
+
+        auto it_center = json_unit.find("center");
+        if (it_center != json_unit.end()) {
+          vector<double> vec_center = *it_center;
+          center = Vector3D(vec_center[0], vec_center[1], vec_center[2]);
+        } else {
+          incompleteObjectError("box", "center");
+        }
+
+        auto it_half_extents = json_unit.find("half extents");
+        if (it_half_extents != json_unit.end()) {
+          vector<double> vec_half_extents = *it_half_extents;
+          half_extents = Vector3D(vec_half_extents[0], vec_half_extents[1], vec_half_extents[2]);
+        } else {
+          incompleteObjectError("box", "half extents");
+        }
+
+        // Orientation as the box's x and y axes, z follows
+        auto it_x_axis = json_unit.find("x axis");
+        if (it_x_axis != json_unit.end()) {
+          vector<double> vec_x_axis = *it_x_axis;
+          x_axis = Vector3D(vec_x_axis[0], vec_x_axis[1], vec_x_axis[2]);
+        }
+
+        auto it_y_axis = json_unit.find("y axis");
+        if (it_y_axis != json_unit.end()) {
+          vector<double> vec_y_axis = *it_y_axis;
+          y_axis = Vector3D(vec_y_axis[0], vec_y_axis[1], vec_y_axis[2]);
+        }
+
+        if (cross(x_axis, y_axis).norm() < 1e-8) {
+          cout << "Invalid box axes, x axis and y axis are parallel" << endl;
+          exit(-1);
+        }
+
+        auto it_friction = json_unit.find("friction");
+        if (it_friction != json_unit.end()) {
+          friction = *it_friction;
+        } else {
+          incompleteObjectError("box", "friction");
+        }
+
+        objects->push_back(new OBB(center, x_axis, y_axis, half_extents, friction));
+      }
+    }
+  }
+  i.close();
+}
+
+void buildScene(HairVector *hairs, Cloth *&cloth, ClothParameters *&cp,
+                vector<CollisionObject *> *objects, bool has_cloth) {
+  // Initialize the Hair object
+  Vector3D start_pos = Vector3D();
+  for (int i = 0; i < hairs->num_hairs; i++) {
+    start_pos.x = 3.0 * (i % 5) + hairs->uniform() * 2.0;
+    start_pos.y = 3.0 * (i / 5) + hairs->uniform() * 2.0;
+    hairs->buildGrid(start_pos);
+  }
+
+  hairs->collision_objects = objects;
+
+  // Initialize the Cloth object
+  if (has_cloth) {
+    cloth->buildGrid();
+    cloth->buildClothMesh();
+  } else {
+    delete cloth;
+    delete cp;
+    cloth = nullptr;
+    cp = nullptr;
+  }
+}
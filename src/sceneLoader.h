@@ -0,0 +1,23 @@
+#ifndef CLOTHSIM_SCENELOADER_H
+#define CLOTHSIM_SCENELOADER_H
+
+#include <string>
+#include <vector>
+
+#include "HairVector.h"
+#include "cloth.h"
+#include "collision/collisionObject.h"
+
+using namespace std;
+
+// Reads the groom and solver parameters, the cloth, its parameters and the
+// colliders of a JSON scene. Prints and exits on a malformed scene.
+void loadObjectsFromFile(string filename, HairVector *hairs, Cloth *cloth, ClothParameters *cp,
+                         vector<CollisionObject *> *objects, bool *has_cloth);
+
+// Grows the strands and lays out the cloth once the scene is read. Without a
+// cloth in the scene, cloth and cp are freed and set to null.
+void buildScene(HairVector *hairs, Cloth *&cloth, ClothParameters *&cp,
+                vector<CollisionObject *> *objects, bool has_cloth);
+
+#endif //CLOTHSIM_SCENELOADER_H
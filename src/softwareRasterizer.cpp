@@ -0,0 +1,315 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "softwareRasterizer.h"
+#include "png.h"
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height) : width(width), height(height) {
+  tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+  tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+  pixels.resize(width * height);
+  depth.resize(width * height);
+  view_projection.setIdentity();
+}
+
+void SoftwareRasterizer::setViewProjection(const Eigen::Matrix4f &view_projection) {
+  this->view_projection = view_projection;
+}
+
+void SoftwareRasterizer::clear(const CGL::Color &background) {
+  fill(pixels.begin(), pixels.end(), pack(background));
+  fill(depth.begin(), depth.end(), 1.0f);
+
+  x.clear();
+  y.clear();
+  z.clear();
+  lines.clear();
+  line_colors.clear();
+  triangles.clear();
+  triangle_colors.clear();
+}
+
+uint32_t SoftwareRasterizer::pack(const CGL::Color &color) {
+  const float channels[4] = {color.r, color.g, color.b, color.a};
+  unsigned char rgba[4];
+  for (int k = 0; k < 4; k++) {
+    rgba[k] = (unsigned char) (min(max(channels[k], 0.0f), 1.0f) * 255.0f + 0.5f);
+  }
+  uint32_t packed;
+  memcpy(&packed, rgba, sizeof(packed));
+  return packed;
+}
+
+int SoftwareRasterizer::addVertex(const Vector3D &p) {
+  x.push_back(p.x);
+  y.push_back(p.y);
+  z.push_back(p.z);
+  return x.size() - 1;
+}
+
+void SoftwareRasterizer::addLine(const Vector3D &a, const Vector3D &b,
+                                 const CGL::Color &color) {
+  int first = addVertex(a);
+  addVertex(b);
+  lines.push_back(first);
+  lines.push_back(first + 1);
+  line_colors.push_back(pack(color));
+}
+
+void SoftwareRasterizer::addLineStrip(const vector<Vector3D> &points,
+                                      const CGL::Color &color) {
+  if (points.size() < 2) return;
+
+  uint32_t packed = pack(color);
+  int first = x.size();
+  for (const Vector3D &p : points) {
+    addVertex(p);
+  }
+  for (int i = 0; i + 1 < points.size(); i++) {
+    lines.push_back(first + i);
+    lines.push_back(first + i + 1);
+    line_colors.push_back(packed);
+  }
+}
+
+void SoftwareRasterizer::addTriangle(const Vector3D &a, const Vector3D &b, const Vector3D &c,
+                                     const CGL::Color &color) {
+  int first = addVertex(a);
+  addVertex(b);
+  addVertex(c);
+  triangles.push_back(first);
+  triangles.push_back(first + 1);
+  triangles.push_back(first + 2);
+  triangle_colors.push_back(pack(color));
+}
+
+// Counting sort of the primitives by the tiles their bounds cover, in the
+// order they were added
+template <typename T>
+static void bin(const vector<T> &primitives, const vector<int32_t> &bounds, int num_tiles,
+                int tiles_x, vector<int32_t> &start, vector<T> &binned) {
+  start.assign(num_tiles + 1, 0);
+  for (int i = 0; i < primitives.size(); i++) {
+    const int32_t *b = &bounds[4 * i];
+    for (int ty = b[1]; ty <= b[3]; ty++) {
+      for (int tx = b[0]; tx <= b[2]; tx++) {
+        start[ty * tiles_x + tx + 1]++;
+      }
+    }
+  }
+  for (int t = 0; t < num_tiles; t++) {
+    start[t + 1] += start[t];
+  }
+
+  binned.resize(start[num_tiles]);
+  vector<int32_t> next(start.begin(), start.end() - 1);
+  for (int i = 0; i < primitives.size(); i++) {
+    const int32_t *b = &bounds[4 * i];
+    for (int ty = b[1]; ty <= b[3]; ty++) {
+      for (int tx = b[0]; tx <= b[2]; tx++) {
+        binned[next[ty * tiles_x + tx]++] = primitives[i];
+      }
+    }
+  }
+}
+
+void SoftwareRasterizer::render() {
+  int num_vertices = x.size();
+  cx.resize(num_vertices);
+  cy.resize(num_vertices);
+  cz.resize(num_vertices);
+  cw.resize(num_vertices);
+
+  const Eigen::Matrix4f &m = view_projection;
+#pragma omp parallel for
+  for (int i = 0; i < num_vertices; i++) {
+    cx[i] = m(0, 0) * x[i] + m(0, 1) * y[i] + m(0, 2) * z[i] + m(0, 3);
+    cy[i] = m(1, 0) * x[i] + m(1, 1) * y[i] + m(1, 2) * z[i] + m(1, 3);
+    cz[i] = m(2, 0) * x[i] + m(2, 1) * y[i] + m(2, 2) * z[i] + m(2, 3);
+    cw[i] = m(3, 0) * x[i] + m(3, 1) * y[i] + m(3, 2) * z[i] + m(3, 3);
+  }
+
+  setupLines();
+  setupTriangles();
+
+  int num_tiles = tiles_x * tiles_y;
+  bin(screen_lines, line_bounds, num_tiles, tiles_x, line_start, binned_lines);
+  bin(screen_triangles, triangle_bounds, num_tiles, tiles_x, triangle_start, binned_triangles);
+
+#pragma omp parallel for schedule(dynamic)
+  for (int t = 0; t < num_tiles; t++) {
+    rasterizeTile(t);
+  }
+}
+
+// Clip coordinates to x, y in pixels (top row first) and depth
+static inline void toScreen(const float *p, int width, int height, float &x, float &y,
+                            float &z) {
+  float inv_w = 1.0f / p[3];
+  x = (0.5f + 0.5f * p[0] * inv_w) * width;
+  y = (0.5f - 0.5f * p[1] * inv_w) * height;
+  z = p[2] * inv_w;
+}
+
+// Tiles covered by the screen rectangle, or an empty range when it is off
+// screen
+static inline void tileBounds(float min_x, float min_y, float max_x, float max_y, int width,
+                              int height, int tile_size, int32_t *bounds) {
+  if (!(max_x >= 0 && min_x < width && max_y >= 0 && min_y < height)) {
+    bounds[0] = 0;
+    bounds[1] = 0;
+    bounds[2] = -1;
+    bounds[3] = -1;
+    return;
+  }
+  bounds[0] = (int) max(min_x, 0.0f) / tile_size;
+  bounds[1] = (int) max(min_y, 0.0f) / tile_size;
+  bounds[2] = (int) min(max_x, width - 1.0f) / tile_size;
+  bounds[3] = (int) min(max_y, height - 1.0f) / tile_size;
+}
+
+void SoftwareRasterizer::setupLines() {
+  int num_lines = line_colors.size();
+  screen_lines.resize(num_lines);
+  line_bounds.resize(num_lines * 4);
+
+#pragma omp parallel for
+  for (int l = 0; l < num_lines; l++) {
+    int a = lines[2 * l], b = lines[2 * l + 1];
+    float pa[4] = {cx[a], cy[a], cz[a], cw[a]};
+    float pb[4] = {cx[b], cy[b], cz[b], cw[b]};
+    int32_t *bounds = &line_bounds[4 * l];
+
+    // Signed distances to the near plane, z = -w
+    float da = pa[2] + pa[3], db = pb[2] + pb[3];
+    if (da < 0 && db < 0) {
+      tileBounds(-1, -1, -1, -1, width, height, TILE_SIZE, bounds);
+      continue;
+    }
+    if (da < 0 || db < 0) {
+      float t = da / (da - db);
+      float clipped[4];
+      for (int k = 0; k < 4; k++) {
+        clipped[k] = pa[k] + t * (pb[k] - pa[k]);
+      }
+      memcpy(da < 0 ? pa : pb, clipped, sizeof(clipped));
+    }
+
+    ScreenLine &s = screen_lines[l];
+    toScreen(pa, width, height, s.x0, s.y0, s.z0);
+    toScreen(pb, width, height, s.x1, s.y1, s.z1);
+    s.color = line_colors[l];
+    tileBounds(min(s.x0, s.x1), min(s.y0, s.y1), max(s.x0, s.x1), max(s.y0, s.y1), width,
+               height, TILE_SIZE, bounds);
+  }
+}
+
+// Triangles are few (the head), so ones that cross the near plane are
+// dropped rather than clipped
+void SoftwareRasterizer::setupTriangles() {
+  int num_triangles = triangle_colors.size();
+  screen_triangles.resize(num_triangles);
+  triangle_bounds.resize(num_triangles * 4);
+
+  for (int t = 0; t < num_triangles; t++) {
+    int32_t *bounds = &triangle_bounds[4 * t];
+    ScreenTriangle &s = screen_triangles[t];
+    bool visible = true;
+    for (int c = 0; c < 3; c++) {
+      int v = triangles[3 * t + c];
+      float p[4] = {cx[v], cy[v], cz[v], cw[v]};
+      visible = visible && p[2] + p[3] >= 0;
+      toScreen(p, width, height, s.x[c], s.y[c], s.z[c]);
+    }
+    s.color = triangle_colors[t];
+    if (!visible) {
+      tileBounds(-1, -1, -1, -1, width, height, TILE_SIZE, bounds);
+      continue;
+    }
+    tileBounds(min(min(s.x[0], s.x[1]), s.x[2]), min(min(s.y[0], s.y[1]), s.y[2]),
+               max(max(s.x[0], s.x[1]), s.x[2]), max(max(s.y[0], s.y[1]), s.y[2]), width,
+               height, TILE_SIZE, bounds);
+  }
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile) {
+  int x0 = (tile % tiles_x) * TILE_SIZE, y0 = (tile / tiles_x) * TILE_SIZE;
+  int x1 = min(x0 + TILE_SIZE, width), y1 = min(y0 + TILE_SIZE, height);
+
+  // Flat triangles, covering the pixels whose centers are inside
+  for (int i = triangle_start[tile]; i < triangle_start[tile + 1]; i++) {
+    const ScreenTriangle &s = binned_triangles[i];
+    float area = (s.x[1] - s.x[0]) * (s.y[2] - s.y[0]) - (s.y[1] - s.y[0]) * (s.x[2] - s.x[0]);
+    if (area == 0) continue;
+    float inv_area = 1.0f / area;
+
+    int px0 = (int) max(min(min(s.x[0], s.x[1]), s.x[2]), (float) x0);
+    int py0 = (int) max(min(min(s.y[0], s.y[1]), s.y[2]), (float) y0);
+    int px1 = min(x1 - 1, (int) min(max(max(s.x[0], s.x[1]), s.x[2]), (float) x1));
+    int py1 = min(y1 - 1, (int) min(max(max(s.y[0], s.y[1]), s.y[2]), (float) y1));
+    for (int py = py0; py <= py1; py++) {
+      float fy = py + 0.5f;
+      for (int px = px0; px <= px1; px++) {
+        float fx = px + 0.5f;
+        float w0 = ((s.x[2] - s.x[1]) * (fy - s.y[1]) - (s.y[2] - s.y[1]) * (fx - s.x[1]));
+        float w1 = ((s.x[0] - s.x[2]) * (fy - s.y[2]) - (s.y[0] - s.y[2]) * (fx - s.x[2]));
+        w0 *= inv_area;
+        w1 *= inv_area;
+        float w2 = 1.0f - w0 - w1;
+        if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+
+        float d = w0 * s.z[0] + w1 * s.z[1] + w2 * s.z[2];
+        int p = py * width + px;
+        if (d < depth[p]) {
+          depth[p] = d;
+          pixels[p] = s.color;
+        }
+      }
+    }
+  }
+
+  // One pixel per column (or row, for steep lines) at the line's height
+  // there, so a line comes out the same whichever tiles it crosses
+  for (int i = line_start[tile]; i < line_start[tile + 1]; i++) {
+    const ScreenLine &s = binned_lines[i];
+    float dx = s.x1 - s.x0, dy = s.y1 - s.y0, dz = s.z1 - s.z0;
+
+    bool steep = fabsf(dy) > fabsf(dx);
+    float major_start = steep ? s.y0 : s.x0, major_delta = steep ? dy : dx;
+    float minor_start = steep ? s.x0 : s.y0, minor_delta = steep ? dx : dy;
+    int major_lo = steep ? y0 : x0, major_hi = steep ? y1 : x1;
+    int minor_lo = steep ? x0 : y0, minor_hi = steep ? x1 : y1;
+    if (major_delta == 0) continue;
+
+    float lo = min(major_start, major_start + major_delta);
+    float hi = max(major_start, major_start + major_delta);
+    int first = max(major_lo, (int) ceilf(max(lo, major_lo - 1.0f) - 0.5f));
+    int last = min(major_hi - 1, (int) floorf(min(hi, major_hi + 1.0f) - 0.5f));
+
+    float inv = 1.0f / major_delta;
+    float t = (first + 0.5f - major_start) * inv;
+    float minor = minor_start + t * minor_delta, minor_step = minor_delta * inv;
+    float d = s.z0 + t * dz, d_step = dz * inv;
+    int major_stride = steep ? width : 1, minor_stride = steep ? 1 : width;
+    for (int m = first; m <= last; m++, minor += minor_step, d += d_step) {
+      if (!(minor >= minor_lo && minor < minor_hi)) continue;
+
+      int p = m * major_stride + (int) minor * minor_stride;
+      if (d < depth[p]) {
+        depth[p] = d;
+        pixels[p] = s.color;
+      }
+    }
+  }
+}
+
+bool SoftwareRasterizer::save(const string &filename) {
+  PNG png;
+  png.width = width;
+  png.height = height;
+  png.pixels.resize(pixels.size() * 4);
+  memcpy(png.pixels.data(), pixels.data(), png.pixels.size());
+  return PNGParser::save(filename.c_str(), png) == 0;
+}
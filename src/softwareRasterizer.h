@@ -0,0 +1,100 @@
+#ifndef CLOTHSIM_SOFTWARERASTERIZER_H
+#define CLOTHSIM_SOFTWARERASTERIZER_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "CGL/color.h"
+#include "CGL/vector3D.h"
+
+using namespace CGL;
+using namespace std;
+
+/**
+ * Draws lines and flat triangles on the CPU into an RGBA image with a depth
+ * buffer, for rendering where there is no GPU or display.
+ *
+ * Primitives are only recorded when they are added. render() projects the
+ * vertices with the view projection matrix (the OpenGL convention, as the
+ * viewer uses), clips lines against the near plane, sorts the primitives
+ * into bins of TILE_SIZE pixels square and rasterizes the tiles in
+ * parallel. Every pixel belongs to exactly one tile, so the threads never
+ * share a pixel.
+ */
+class SoftwareRasterizer {
+public:
+  SoftwareRasterizer(int width, int height);
+
+  void setViewProjection(const Eigen::Matrix4f &view_projection);
+
+  // Forgets all primitives and fills the image with background
+  void clear(const CGL::Color &background);
+
+  void addLine(const Vector3D &a, const Vector3D &b, const CGL::Color &color);
+  void addLineStrip(const vector<Vector3D> &points, const CGL::Color &color);
+  void addTriangle(const Vector3D &a, const Vector3D &b, const Vector3D &c,
+                   const CGL::Color &color);
+
+  void render();
+
+  // Writes the image through PNGParser
+  bool save(const string &filename);
+
+  int width, height;
+
+  // RGBA bytes per pixel, top row first
+  vector<uint32_t> pixels;
+  // Normalized device depth, 1 at the far plane
+  vector<float> depth;
+
+  static const int TILE_SIZE = 32;
+
+private:
+  // Primitives after projection, x and y in pixels
+  struct ScreenLine {
+    float x0, y0, z0;
+    float x1, y1, z1;
+    uint32_t color;
+  };
+
+  struct ScreenTriangle {
+    float x[3], y[3], z[3];
+    uint32_t color;
+  };
+
+  int addVertex(const Vector3D &p);
+  static uint32_t pack(const CGL::Color &color);
+
+  void setupLines();
+  void setupTriangles();
+  void rasterizeTile(int tile);
+
+  Eigen::Matrix4f view_projection;
+  int tiles_x, tiles_y;
+
+  // World space vertices, then their clip coordinates
+  vector<float> x, y, z;
+  vector<float> cx, cy, cz, cw;
+
+  // Vertex indices and colors per primitive
+  vector<int32_t> lines, triangles;
+  vector<uint32_t> line_colors, triangle_colors;
+
+  // Screen space primitives with the rectangle of tiles they touch (x0, y0,
+  // x1, y1 inclusive, empty when culled)
+  vector<ScreenLine> screen_lines;
+  vector<ScreenTriangle> screen_triangles;
+  vector<int32_t> line_bounds, triangle_bounds;
+
+  // Copies of the primitives sorted by tile, those of tile t at
+  // [start[t], start[t + 1]), so each tile reads its own contiguous range
+  vector<int32_t> line_start, triangle_start;
+  vector<ScreenLine> binned_lines;
+  vector<ScreenTriangle> binned_triangles;
+};
+
+#endif //CLOTHSIM_SOFTWARERASTERIZER_H
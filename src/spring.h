@@ -10,7 +10,7 @@ using namespace std;
 
 namespace CGL {
 
-//enum e_spring_type { STRUCTURAL = 0, SHEARING = 1, BENDING = 2 };
+enum e_spring_type { STRUCTURAL = 0, SHEARING = 1, BENDING = 2 };
 
 struct Spring {
   Spring(PointMass *a, PointMass *b)
@@ -0,0 +1,57 @@
+#include <math.h>
+
+#include "stepController.h"
+
+using namespace std;
+
+int StepController::advanceFrame(HairVector *hairs, double frames_per_sec,
+                                 vector<Vector3D> external_accelerations) {
+  double frame_t = 1.0 / frames_per_sec;
+  double min_dt = frame_t / max_steps;
+  double max_dt = frame_t / min_steps;
+
+  double dt = delta_t > 0 ? delta_t : max_dt;
+  double remaining = frame_t;
+  int steps = 0;
+
+  while (remaining > 1e-12) {
+    dt = min(max(dt, min_dt), max_dt);
+
+    // Spread what is left of the frame evenly over the substeps it needs
+    int n = (int) ceil(remaining / dt - 1e-9);
+    double step_dt = remaining / n;
+
+    sync(hairs, step_dt);
+    hairs->simulate(frames_per_sec, frame_t / step_dt, external_accelerations);
+    remaining -= step_dt;
+    steps++;
+
+    double cfl, strain;
+    hairs->stepMetrics(step_dt, cfl, strain);
+
+    // Shrink quickly, grow slowly
+    double scale = min(target_cfl / max(cfl, 1e-12), target_strain / max(strain, 1e-12));
+    dt = step_dt * min(max(scale, 0.5), 1.25);
+  }
+
+  // Carry the preferred step into the next frame
+  delta_t = min(max(dt, min_dt), max_dt);
+  sync(hairs, delta_t);
+
+  last_frame_steps = steps;
+  last_frame_particle_steps = (long) steps * hairs->totalParticles();
+  total_steps += steps;
+  total_frames++;
+
+  return steps;
+}
+
+void StepController::sync(HairVector *hairs, double delta_t) {
+  hairs->setStepSize(delta_t);
+  this->delta_t = delta_t;
+}
+
+double StepController::averageSteps() {
+  if (total_frames == 0) return 0;
+  return (double) total_steps / total_frames;
+}
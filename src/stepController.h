@@ -0,0 +1,49 @@
+#ifndef CLOTHSIM_STEPCONTROLLER_H
+#define CLOTHSIM_STEPCONTROLLER_H
+
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "HairVector.h"
+
+using namespace CGL;
+using namespace std;
+
+/**
+ * Picks the substep size for each frame from the state after the previous
+ * substep: the fastest particle may only travel target_cfl of a spring length
+ * per substep, and the strain of no spring may change by more than
+ * target_strain per substep, that is |length - last length| / rest length
+ * (Hair::stepMetrics). The strain itself is bounded by the 10% clamp.
+ */
+struct StepController {
+  StepController() {}
+
+  // Advances the hairs by one frame and returns the number of substeps taken.
+  int advanceFrame(HairVector *hairs, double frames_per_sec,
+                   vector<Vector3D> external_accelerations);
+
+  // Switches to a fixed substep size, rescaling the Verlet velocities if it
+  // differs from the one the hairs were last stepped with.
+  void sync(HairVector *hairs, double delta_t);
+
+  double averageSteps();
+
+  // Bounds on the number of substeps per frame
+  int min_steps = 4;
+  int max_steps = 60;
+
+  double target_cfl = 0.02;
+  double target_strain = 0.01;
+
+  // Substep size used last
+  double delta_t = 0;
+
+  // Cost accounting
+  int last_frame_steps = 0;
+  long last_frame_particle_steps = 0;
+  long total_steps = 0;
+  long total_frames = 0;
+};
+
+#endif //CLOTHSIM_STEPCONTROLLER_H
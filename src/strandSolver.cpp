@@ -0,0 +1,57 @@
+#include <map>
+
+#include "strandSolver.h"
+#include "massSpringSolver.h"
+#include "elasticRod.h"
+
+using namespace std;
+
+static StrandSolver *createMassSpring() { return new MassSpringSolver(); }
+static StrandSolver *createElasticRod() { return new ElasticRods(); }
+
+// Built in engines are added on first use, so other translation units may
+// register from their static initializers without ordering concerns
+static map<string, StrandSolverFactory> &registry() {
+  static map<string, StrandSolverFactory> solvers = {
+      {"mass spring", createMassSpring},
+      {"elastic rod", createElasticRod},
+  };
+  return solvers;
+}
+
+void registerStrandSolver(const string &name, StrandSolverFactory factory) {
+  registry()[name] = factory;
+}
+
+StrandSolver *createStrandSolver(const string &name) {
+  auto it = registry().find(name);
+  return it == registry().end() ? nullptr : it->second();
+}
+
+vector<string> strandSolverNames() {
+  vector<string> names;
+  for (auto &entry : registry()) {
+    names.push_back(entry.first);
+  }
+  return names;
+}
+
+void StrandSolver::exportState(Hair *hair, int index, vector<double> &state) {
+  for (PointMass &pm : hair->point_masses) {
+    state.push_back(pm.position.x);
+    state.push_back(pm.position.y);
+    state.push_back(pm.position.z);
+    state.push_back(pm.last_position.x);
+    state.push_back(pm.last_position.y);
+    state.push_back(pm.last_position.z);
+  }
+}
+
+size_t StrandSolver::importState(Hair *hair, int index, const vector<double> &state, size_t offset) {
+  for (PointMass &pm : hair->point_masses) {
+    pm.position = Vector3D(state[offset], state[offset + 1], state[offset + 2]);
+    pm.last_position = Vector3D(state[offset + 3], state[offset + 4], state[offset + 5]);
+    offset += 6;
+  }
+  return offset;
+}
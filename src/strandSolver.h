@@ -0,0 +1,66 @@
+#ifndef CLOTHSIM_STRANDSOLVER_H
+#define CLOTHSIM_STRANDSOLVER_H
+
+#include <string>
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "hair.h"
+
+using namespace CGL;
+using namespace std;
+
+struct HairVector;
+
+struct StrandSolverStats {
+  long steps = 0;           // simulate calls
+  long strand_steps = 0;
+  long particle_steps = 0;
+  double seconds = 0;       // spent in step
+};
+
+/**
+ * Integrates the internal forces of a strand. HairVector::simulate applies
+ * the root animation, external forces, force fields and volume forces to the
+ * point masses and then hands each awake strand to its solver, so engines
+ * can be swapped on the same groom.
+ */
+class StrandSolver {
+public:
+  virtual ~StrandSolver() {}
+
+  virtual string name() = 0;
+
+  // Advances strand index of the hairs by one substep. The external forces
+  // are already in the point masses.
+  virtual void step(HairVector *hairs, Hair *hair, int index,
+                    double frames_per_sec, double simulation_steps) = 0;
+
+  // Drops all per strand state, it is rebuilt from the strands on the next
+  // step.
+  virtual void reset(HairVector *hairs) {}
+
+  // Appends the state of strand index to state, and reads it back from
+  // state starting at offset, returning the offset past it. The default
+  // covers the particle positions, which is all the spring model keeps.
+  virtual void exportState(Hair *hair, int index, vector<double> &state);
+  virtual size_t importState(Hair *hair, int index, const vector<double> &state, size_t offset);
+
+  // Doubles exportState writes for a strand of that many particles
+  virtual size_t stateSize(int particles) { return (size_t) particles * 6; }
+
+  StrandSolverStats stats;
+};
+
+typedef StrandSolver *(*StrandSolverFactory)();
+
+// Makes name available to createStrandSolver. The built in engines are
+// "mass spring" and "elastic rod".
+void registerStrandSolver(const string &name, StrandSolverFactory factory);
+
+// Returns a new solver registered under name, or nullptr.
+StrandSolver *createStrandSolver(const string &name);
+
+vector<string> strandSolverNames();
+
+#endif //CLOTHSIM_STRANDSOLVER_H
@@ -0,0 +1,105 @@
+// Saves a checkpoint part way through a scene, restores it into a freshly
+// loaded copy of the scene and checks that the restored run continues
+// exactly like the uninterrupted one. The run after the checkpoint uses a
+// different number of substeps per frame, so the saved Verlet velocities
+// have to be rescaled to the new substep.
+//
+// Usage: checkpointTest <scene.json> <checkpoint file> [options]
+//   --frames <n>  frames before and after the checkpoint (default 6)
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <vector>
+
+#include "HairVector.h"
+#include "checkpoint.h"
+#include "cloth.h"
+#include "sceneLoader.h"
+
+using namespace std;
+
+// The viewer's defaults, 15 steps per frame, then a coarser step after the
+// checkpoint
+static const int FRAMES_PER_SEC = 24;
+static const int STEPS_BEFORE = 15;
+static const int STEPS_AFTER = 10;
+
+static void load(const string &scene_file, HairVector &hairs) {
+  Cloth *cloth = new Cloth();
+  ClothParameters *cp = new ClothParameters();
+  vector<CollisionObject *> *objects = new vector<CollisionObject *>();
+  bool has_cloth = false;
+  loadObjectsFromFile(scene_file, &hairs, cloth, cp, objects, &has_cloth);
+  buildScene(&hairs, cloth, cp, objects, has_cloth);
+}
+
+static void run(HairVector &hairs, int frames, int simulation_steps) {
+  vector<Vector3D> external_accelerations = {Vector3D(0, -9.8, 0), Vector3D()};
+  for (int f = 0; f < frames; f++) {
+    for (int i = 0; i < simulation_steps; i++) {
+      hairs.simulate(FRAMES_PER_SEC, simulation_steps, external_accelerations);
+    }
+    hairs.frame++;
+  }
+}
+
+static vector<Vector3D> positions(HairVector &hairs) {
+  vector<Vector3D> all;
+  for (Hair *hair : *hairs.hair_vector) {
+    for (PointMass &pm : hair->point_masses) {
+      all.push_back(pm.position);
+      all.push_back(pm.last_position);
+    }
+  }
+  return all;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    cout << "Usage: " << argv[0] << " <scene.json> <checkpoint file> [--frames n]" << endl;
+    return 2;
+  }
+  string scene_file = argv[1], checkpoint_file = argv[2];
+  int frames = 6;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else {
+      cout << "Unknown option " << argv[i] << endl;
+      return 2;
+    }
+  }
+
+  HairVector uninterrupted;
+  load(scene_file, uninterrupted);
+  run(uninterrupted, frames, STEPS_BEFORE);
+  if (!saveCheckpoint(checkpoint_file, &uninterrupted)) return 1;
+  run(uninterrupted, frames, STEPS_AFTER);
+
+  HairVector restored;
+  load(scene_file, restored);
+  if (!loadCheckpoint(checkpoint_file, &restored)) return 1;
+  run(restored, frames, STEPS_AFTER);
+
+  // Same arithmetic in the same order, so the states match bit for bit
+  vector<Vector3D> expected = positions(uninterrupted), actual = positions(restored);
+  if (expected.size() != actual.size()) {
+    cout << "FAILED: restored run has " << actual.size() / 2 << " particles, expected "
+         << expected.size() / 2 << endl;
+    return 1;
+  }
+  double worst = 0;
+  for (int i = 0; i < expected.size(); i++) {
+    worst = max(worst, (actual[i] - expected[i]).norm());
+  }
+  cout << scene_file << ", " << expected.size() / 2 << " particles, max deviation " << worst
+       << " after " << frames << " frames from frame " << frames << endl;
+  if (worst != 0) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+}
@@ -0,0 +1,207 @@
+// Runs a scene headless for a number of frames and compares the particle
+// positions after every frame against a golden cache written by an earlier,
+// trusted build. Reports the maximum and RMS deviation per frame and the
+// first frame that leaves the tolerance.
+//
+// Usage: regressionTest <scene.json> <golden file> [options]
+//   --update         write the golden file instead of comparing
+//   --frames <n>     frames to simulate (default 24)
+//   --tolerance <t>  allowed deviation as a fraction of the size of the
+//                    scene (default 1e-4)
+//   --animation <f>  drive the strand roots with a keyframe file, as the
+//                    viewer's -a option does
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "HairVector.h"
+#include "cloth.h"
+#include "rootAnimation.h"
+#include "sceneLoader.h"
+
+using namespace std;
+
+static const char GOLDEN_MAGIC[8] = {'H', 'A', 'I', 'R', 'G', 'O', 'L', 'D'};
+static const uint32_t GOLDEN_VERSION = 1;
+
+// Particles kept per frame, spread evenly over strands and cloth
+static const int MAX_SAMPLES = 128;
+
+struct GoldenHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t frames;
+  uint32_t samples;
+};
+
+static vector<Vector3D *> particles(HairVector &hairs, Cloth *cloth) {
+  vector<Vector3D *> all;
+  for (Hair *hair : *hairs.hair_vector) {
+    for (PointMass &pm : hair->point_masses) {
+      all.push_back(&pm.position);
+    }
+  }
+  if (cloth) {
+    for (PointMass &pm : cloth->point_masses) {
+      all.push_back(&pm.position);
+    }
+  }
+
+  if (all.size() <= MAX_SAMPLES) return all;
+  vector<Vector3D *> samples;
+  for (int i = 0; i < MAX_SAMPLES; i++) {
+    samples.push_back(all[(size_t) i * all.size() / MAX_SAMPLES]);
+  }
+  return samples;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    cout << "Usage: " << argv[0] << " <scene.json> <golden file> [--update] [--frames n]"
+         << " [--tolerance t] [--animation file]" << endl;
+    return 2;
+  }
+  string scene_file = argv[1], golden_file = argv[2];
+  string animation_file;
+  bool update = false;
+  int frames = 24;
+  double tolerance = 1e-4;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--animation") == 0 && i + 1 < argc) {
+      animation_file = argv[++i];
+    } else {
+      cout << "Unknown option " << argv[i] << endl;
+      return 2;
+    }
+  }
+
+  HairVector hairs;
+  Cloth *cloth = new Cloth();
+  ClothParameters *cp = new ClothParameters();
+  vector<CollisionObject *> *objects = new vector<CollisionObject *>();
+  bool has_cloth = false;
+  loadObjectsFromFile(scene_file, &hairs, cloth, cp, objects, &has_cloth);
+  buildScene(&hairs, cloth, cp, objects, has_cloth);
+
+  if (!animation_file.empty()) {
+    hairs.root_animation = new RootAnimation();
+    if (!hairs.root_animation->load(animation_file)) return 1;
+    hairs.root_animation->bind(&hairs);
+  }
+
+  // The viewer's defaults: 24 frames of 15 steps under gravity, and the
+  // arrow key acceleration, which is zero without input
+  int frames_per_sec = 24, simulation_steps = 15;
+  vector<Vector3D> external_accelerations = {Vector3D(0, -9.8, 0), Vector3D()};
+
+  vector<Vector3D *> samples = particles(hairs, cloth);
+  vector<float> trajectory;
+  for (int f = 0; f < frames; f++) {
+    for (int i = 0; i < simulation_steps; i++) {
+      hairs.simulate(frames_per_sec, simulation_steps, external_accelerations);
+    }
+    if (cloth) {
+      for (int i = 0; i < simulation_steps; i++) {
+        cloth->simulate(frames_per_sec, simulation_steps, cp, external_accelerations, objects);
+      }
+    }
+    hairs.frame++;
+
+    for (Vector3D *p : samples) {
+      trajectory.push_back(p->x);
+      trajectory.push_back(p->y);
+      trajectory.push_back(p->z);
+    }
+  }
+
+  if (update) {
+    GoldenHeader header;
+    memcpy(header.magic, GOLDEN_MAGIC, sizeof(header.magic));
+    header.version = GOLDEN_VERSION;
+    header.frames = frames;
+    header.samples = samples.size();
+    ofstream o(golden_file, ios::binary);
+    o.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    o.write(reinterpret_cast<const char *>(trajectory.data()), trajectory.size() * sizeof(float));
+    if (!o.good()) {
+      cout << "Could not write " << golden_file << endl;
+      return 1;
+    }
+    cout << "Wrote " << frames << " frames of " << samples.size() << " particles to "
+         << golden_file << endl;
+    return 0;
+  }
+
+  ifstream in(golden_file, ios::binary);
+  GoldenHeader header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      memcmp(header.magic, GOLDEN_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != GOLDEN_VERSION) {
+    cout << "Could not read golden file " << golden_file << endl;
+    return 1;
+  }
+  if (header.samples != samples.size() || header.frames < frames) {
+    cout << "Golden file " << golden_file << " has " << header.frames << " frames of "
+         << header.samples << " particles, the run has " << frames << " frames of "
+         << samples.size() << endl;
+    return 1;
+  }
+  vector<float> golden(header.frames * header.samples * 3);
+  if (!in.read(reinterpret_cast<char *>(golden.data()), golden.size() * sizeof(float))) {
+    cout << "Golden file " << golden_file << " is truncated" << endl;
+    return 1;
+  }
+
+  // Deviations are measured against the size of the first golden frame
+  Vector3D lo(golden[0], golden[1], golden[2]), hi = lo;
+  for (int i = 0; i < samples.size() * 3; i += 3) {
+    for (int k = 0; k < 3; k++) {
+      lo[k] = min(lo[k], (double) golden[i + k]);
+      hi[k] = max(hi[k], (double) golden[i + k]);
+    }
+  }
+  double scale = max((hi - lo).norm(), 1e-12);
+  double limit = tolerance * scale;
+
+  double worst = 0, sum2 = 0;
+  int diverged = -1;
+  cout << scene_file << ", " << frames << " frames of " << samples.size()
+       << " particles, tolerance " << limit << endl;
+  cout << "frame  max deviation  rms deviation" << endl;
+  for (int f = 0; f < frames; f++) {
+    double frame_worst = 0, frame_sum2 = 0;
+    for (int s = 0; s < samples.size(); s++) {
+      int i = (f * samples.size() + s) * 3;
+      // The stored positions are single precision
+      Vector3D d(trajectory[i] - golden[i], trajectory[i + 1] - golden[i + 1],
+                 trajectory[i + 2] - golden[i + 2]);
+      frame_worst = max(frame_worst, d.norm());
+      frame_sum2 += d.norm2();
+    }
+    worst = max(worst, frame_worst);
+    sum2 += frame_sum2;
+    if (diverged < 0 && frame_worst > limit) diverged = f;
+    printf("%5d  %13.6g  %13.6g\n", f, frame_worst, sqrt(frame_sum2 / samples.size()));
+  }
+
+  double rms = sqrt(sum2 / (frames * samples.size()));
+  cout << "max deviation " << worst << ", rms " << rms << endl;
+  if (diverged >= 0) {
+    cout << "FAILED: diverged at frame " << diverged << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+}